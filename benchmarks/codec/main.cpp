@@ -0,0 +1,169 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+
+#include "util.h"
+#include "pool.h"
+#include "source.h"
+#include "codec.h"
+#include "sweep.h"
+
+// Statistics of Codec
+struct statistics
+{
+    uint64_t frames = 0;
+    uint64_t raw_bytes = 0;     // Bytes of point cloud (int16x3) and color (BGRA)
+    uint64_t depth_bytes = 0;   // Bytes of depth (DEPTH16)
+    uint64_t encoded_bytes = 0; // Bytes of encoded frames
+    uint64_t encoded_depth_bytes = 0;
+    uint64_t mismatches = 0;    // Frames that were not decoded losslessly
+    std::chrono::duration<double> encode_time;
+    std::chrono::duration<double> decode_depth_time;
+    std::chrono::duration<double> decode_cloud_time;
+};
+
+// Check Decoded Depth Image is Same as Original
+bool equals( const k4a::image& expected, const k4a::image& actual )
+{
+    const size_t row_size = static_cast<size_t>( expected.get_width_pixels() ) * sizeof( uint16_t );
+    for( int32_t y = 0; y < expected.get_height_pixels(); y++ ){
+        if( std::memcmp( expected.get_buffer() + static_cast<size_t>( y ) * expected.get_stride_bytes(), actual.get_buffer() + static_cast<size_t>( y ) * actual.get_stride_bytes(), row_size ) != 0 ){
+            return false;
+        }
+    }
+    return true;
+}
+
+// Benchmark Codec with Captures of Source, and Print Result (Return false if decoded depth doesn't match)
+// (Depth image is transformed to color camera, so point cloud is organized in color camera.)
+bool benchmark( k4a::capture_source& source, const std::string& name, const uint64_t frames )
+{
+    const k4a::calibration calibration = source.get_calibration();
+    k4a::transformation transformation( calibration );
+    k4a::frame_pool pool( calibration );
+    k4a::image transformed_depth_image = pool.get_transformed_depth_image();
+
+    k4a::cloud_encoder encoder( k4a::codec::compression::delta_rle );
+    k4a::cloud_decoder decoder;
+    decoder.register_calibration( calibration );
+    std::vector<uint8_t> frame;
+    cv::Mat xyz, color;
+
+    statistics result;
+    k4a::capture capture;
+    while( result.frames < frames && source.get_capture( &capture, std::chrono::milliseconds( K4A_WAIT_INFINITE ) ) ){
+        const k4a::image depth_image = capture.get_depth_image();
+        if( !depth_image.handle() ){
+            continue;
+        }
+        transformation.depth_image_to_color_camera( depth_image, &transformed_depth_image );
+
+        // Color is encoded only if it is BGRA or MJPG (Recorded MJPG is kept as is without decode)
+        k4a::image color_image = capture.get_color_image();
+        if( color_image.handle() && color_image.get_format() != K4A_IMAGE_FORMAT_COLOR_BGRA32 && color_image.get_format() != K4A_IMAGE_FORMAT_COLOR_MJPG ){
+            color_image.reset();
+        }
+
+        // Encode
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        encoder.encode( calibration, K4A_CALIBRATION_TYPE_COLOR, transformed_depth_image, color_image, frame );
+        result.encode_time += std::chrono::steady_clock::now() - start;
+
+        // Decode Depth
+        start = std::chrono::steady_clock::now();
+        const k4a::image& decoded_depth_image = decoder.decode_depth( frame.data(), frame.size() );
+        result.decode_depth_time += std::chrono::steady_clock::now() - start;
+        if( !equals( transformed_depth_image, decoded_depth_image ) ){
+            result.mismatches++;
+        }
+
+        // Decode Point Cloud (Depth and reconstruction of point cloud with table of rays)
+        start = std::chrono::steady_clock::now();
+        decoder.decode( frame.data(), frame.size(), xyz, color );
+        result.decode_cloud_time += std::chrono::steady_clock::now() - start;
+
+        const k4a::codec::header header = k4a::codec::read_header( frame.data(), frame.size() );
+        const uint64_t pixels = static_cast<uint64_t>( header.width ) * header.height;
+        result.raw_bytes += pixels * 3 * sizeof( int16_t ) + ( header.color_size ? pixels * 4 : 0 );
+        result.depth_bytes += pixels * sizeof( uint16_t );
+        result.encoded_bytes += frame.size();
+        result.encoded_depth_bytes += header.depth_size;
+        result.frames++;
+        capture.reset();
+    }
+    transformation.destroy();
+
+    if( result.frames == 0 ){
+        std::cout << std::setw( 28 ) << std::left << name << "no depth frames" << std::endl;
+        return false;
+    }
+
+    const bool passed = ( result.mismatches == 0 );
+    std::cout << std::setw( 28 ) << std::left << name << std::right
+              << std::setw( 8 ) << result.frames << std::fixed << std::setprecision( 2 )
+              << std::setw( 10 ) << result.raw_bytes / ( 1024.0 * 1024.0 ) / result.frames
+              << std::setw( 10 ) << result.encoded_bytes / ( 1024.0 * 1024.0 ) / result.frames
+              << std::setw( 8 ) << static_cast<double>( result.raw_bytes ) / result.encoded_bytes
+              << std::setw( 8 ) << static_cast<double>( result.depth_bytes ) / result.encoded_depth_bytes
+              << std::setw( 10 ) << result.encode_time.count() * 1000.0 / result.frames
+              << std::setw( 10 ) << result.decode_depth_time.count() * 1000.0 / result.frames
+              << std::setw( 10 ) << result.decode_cloud_time.count() * 1000.0 / result.frames
+              << std::setw( 8 ) << ( passed ? "ok" : "FAILED" ) << std::endl;
+    return passed;
+}
+
+int main( int argc, char* argv[] )
+{
+    // Parse Options
+    // codec [--frames <N>] [file.mkv ...]
+    // (Synthetic frames of every depth mode and color resolution are used if no file is specified.)
+    // (Synthetic depth is smoother than real depth, so use recorded files to measure compression ratio.)
+    uint64_t frames = 30;
+    std::vector<std::string> files;
+    for( int32_t i = 1; i < argc; i++ ){
+        const std::string option = argv[i];
+        if( option == "--frames" && i + 1 < argc ){
+            frames = std::stoull( argv[++i] );
+        }
+        else{
+            files.push_back( option );
+        }
+    }
+
+    bool passed = true;
+    try{
+        std::cout << std::setw( 28 ) << std::left << "source" << std::right
+                  << std::setw( 8 ) << "frames"
+                  << std::setw( 10 ) << "raw MB"
+                  << std::setw( 10 ) << "frame MB"
+                  << std::setw( 8 ) << "ratio"
+                  << std::setw( 8 ) << "depth"
+                  << std::setw( 10 ) << "enc ms"
+                  << std::setw( 10 ) << "dec ms"
+                  << std::setw( 10 ) << "xyz ms"
+                  << std::setw( 8 ) << "result" << std::endl;
+
+        // Recorded Frames
+        for( const std::string& file : files ){
+            k4a::playback_source source( file );
+            passed &= benchmark( source, file, frames );
+        }
+
+        // Synthetic Frames
+        if( files.empty() ){
+            k4a::sweep_synthetic_sources( [&]( k4a::capture_source& source, const std::string& name ){
+                passed &= benchmark( source, name, frames );
+            } );
+        }
+    }
+    catch( const k4a::error& error ){
+        std::cout << error.what() << std::endl;
+        return -1;
+    }
+
+    return passed ? 0 : 1;
+}
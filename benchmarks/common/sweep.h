@@ -0,0 +1,98 @@
+/*
+ This is utility to that provides sweep of depth modes and color resolutions for benchmarks.
+ Synthetic source of every combination is started in turn, so that benchmarks cover every configuration without device.
+
+ k4a::sweep_synthetic_sources( [&]( k4a::capture_source& source, const std::string& name ){
+     ... // name is "<depth mode> <color resolution>" (e.g. "NFOV_UNBINNED 720P")
+ } );
+
+ std::cout << k4a::to_string( calibration.depth_mode ) << " " << k4a::to_string( calibration.color_resolution ) << std::endl;
+
+ Copyright (c) 2019 Tsukasa Sugiura <t.sugiura0204@gmail.com>
+ Licensed under the MIT license.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef __SWEEP__
+#define __SWEEP__
+
+#include <k4a/k4a.hpp>
+
+#include "source.h"
+
+#include <string>
+
+namespace k4a
+{
+    // Depth Modes of Sweep (Passive IR is not included, because it doesn't have depth image)
+    static const k4a_depth_mode_t sweep_depth_modes[] = { K4A_DEPTH_MODE_NFOV_2X2BINNED, K4A_DEPTH_MODE_NFOV_UNBINNED, K4A_DEPTH_MODE_WFOV_2X2BINNED, K4A_DEPTH_MODE_WFOV_UNBINNED };
+
+    // Color Resolutions of Sweep
+    static const k4a_color_resolution_t sweep_color_resolutions[] = { K4A_COLOR_RESOLUTION_720P, K4A_COLOR_RESOLUTION_1080P, K4A_COLOR_RESOLUTION_1440P, K4A_COLOR_RESOLUTION_1536P, K4A_COLOR_RESOLUTION_2160P, K4A_COLOR_RESOLUTION_3072P };
+
+    // Get Name of Depth Mode
+    inline std::string to_string( const k4a_depth_mode_t depth_mode )
+    {
+        switch( depth_mode ){
+            case K4A_DEPTH_MODE_NFOV_2X2BINNED: return "NFOV_2X2BINNED";
+            case K4A_DEPTH_MODE_NFOV_UNBINNED:  return "NFOV_UNBINNED";
+            case K4A_DEPTH_MODE_WFOV_2X2BINNED: return "WFOV_2X2BINNED";
+            case K4A_DEPTH_MODE_WFOV_UNBINNED:  return "WFOV_UNBINNED";
+            case K4A_DEPTH_MODE_PASSIVE_IR:     return "PASSIVE_IR";
+            default:                            return "OFF";
+        }
+    }
+
+    // Get Name of Color Resolution
+    inline std::string to_string( const k4a_color_resolution_t color_resolution )
+    {
+        switch( color_resolution ){
+            case K4A_COLOR_RESOLUTION_720P:  return "720P";
+            case K4A_COLOR_RESOLUTION_1080P: return "1080P";
+            case K4A_COLOR_RESOLUTION_1440P: return "1440P";
+            case K4A_COLOR_RESOLUTION_1536P: return "1536P";
+            case K4A_COLOR_RESOLUTION_2160P: return "2160P";
+            case K4A_COLOR_RESOLUTION_3072P: return "3072P";
+            default:                         return "OFF";
+        }
+    }
+
+    // Run Function with Synthetic Source of Every Combination of Depth Mode and Color Resolution
+    // (Source generates BGRA color as fast as possible, and it is stopped after function returns.)
+    template<typename function>
+    void sweep_synthetic_sources( function run )
+    {
+        for( const k4a_depth_mode_t depth_mode : sweep_depth_modes ){
+            for( const k4a_color_resolution_t color_resolution : sweep_color_resolutions ){
+                k4a_device_configuration_t configuration = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
+                configuration.color_format     = K4A_IMAGE_FORMAT_COLOR_BGRA32;
+                configuration.color_resolution = color_resolution;
+                configuration.depth_mode       = depth_mode;
+
+                k4a::synthetic_source source( false );
+                source.start( configuration );
+                run( source, to_string( depth_mode ) + " " + to_string( color_resolution ) );
+                source.stop();
+            }
+        }
+    }
+}
+
+#endif // __SWEEP__
@@ -0,0 +1,428 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <new>
+
+#include "util.h"
+#include "pool.h"
+#include "source.h"
+#include "unprojection.h"
+#include "voxel.h"
+#include "sweep.h"
+
+// Allocation Counter
+// NOTE: Allocations by operator new and buffers of cv::Mat are counted in the same way on every platform.
+//       Allocations by malloc of C (e.g. buffers of k4a::image that are allocated in Azure Kinect SDK) are not counted.
+static std::atomic<uint64_t> allocations( 0 );
+
+void* operator new( size_t size )
+{
+    allocations.fetch_add( 1, std::memory_order_relaxed );
+    if( void* pointer = std::malloc( size ? size : 1 ) ){
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[]( size_t size )
+{
+    return operator new( size );
+}
+
+void* operator new( size_t size, const std::nothrow_t& ) noexcept
+{
+    allocations.fetch_add( 1, std::memory_order_relaxed );
+    return std::malloc( size ? size : 1 );
+}
+
+void* operator new[]( size_t size, const std::nothrow_t& nothrow ) noexcept
+{
+    return operator new( size, nothrow );
+}
+
+void operator delete( void* pointer ) noexcept
+{
+    std::free( pointer );
+}
+
+void operator delete[]( void* pointer ) noexcept
+{
+    std::free( pointer );
+}
+
+// Allocator for cv::Mat that Counts Allocations of Buffers (cv::Mat::create())
+class counting_allocator : public cv::MatAllocator
+{
+private:
+    const cv::MatAllocator* allocator;
+
+public:
+    #if ( CV_VERSION_MAJOR * 10000 + CV_VERSION_MINOR * 100 + CV_VERSION_REVISION ) < 40101
+    using access_flag = int;
+    #else
+    using access_flag = cv::AccessFlag;
+    #endif
+
+    counting_allocator( const cv::MatAllocator* allocator )
+        : allocator( allocator )
+    {
+    }
+
+    cv::UMatData* allocate( int dims, const int* sizes, int type, void* data, size_t* step, access_flag flags, cv::UMatUsageFlags usage_flags ) const CV_OVERRIDE
+    {
+        if( !data ){
+            allocations.fetch_add( 1, std::memory_order_relaxed );
+        }
+        return allocator->allocate( dims, sizes, type, data, step, flags, usage_flags );
+    }
+
+    bool allocate( cv::UMatData* u, access_flag flags, cv::UMatUsageFlags usage_flags ) const CV_OVERRIDE
+    {
+        return allocator->allocate( u, flags, usage_flags );
+    }
+
+    void deallocate( cv::UMatData* u ) const CV_OVERRIDE
+    {
+        allocator->deallocate( u );
+    }
+};
+
+// Minimum Time to Measure Each Benchmark
+static std::chrono::duration<double> minimum_time( 0.2 );
+
+// Measure Function, and Print Time per Frame, Throughput, and Allocations per Iteration
+// (bytes is size of input frame that is used for throughput)
+template<typename function>
+void measure( const std::string& name, const std::string& mode, const size_t bytes, function run )
+{
+    // Warm Up (e.g. allocation of pool, and lazy initialization of transformation)
+    run();
+
+    uint64_t iterations = 0;
+    const uint64_t allocations_start = allocations.load();
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed( 0.0 );
+    while( elapsed < minimum_time || iterations < 5 ){
+        run();
+        iterations++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    const uint64_t allocated = allocations.load() - allocations_start;
+
+    const double seconds = elapsed.count() / iterations;
+    std::cout << std::setw( 40 ) << std::left << name
+              << std::setw( 26 ) << mode << std::right
+              << std::setw( 14 ) << std::fixed << std::setprecision( 0 ) << seconds * 1e9
+              << std::setw( 12 ) << std::setprecision( 1 ) << bytes / seconds / ( 1024.0 * 1024.0 )
+              << std::setw( 14 ) << std::setprecision( 2 ) << static_cast<double>( allocated ) / iterations
+              << std::endl;
+}
+
+// Get One Capture of Configuration from Synthetic Source
+k4a::capture get_capture( const k4a_image_format_t color_format, const k4a_color_resolution_t color_resolution, const k4a_depth_mode_t depth_mode )
+{
+    k4a_device_configuration_t configuration = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
+    configuration.color_format     = color_format;
+    configuration.color_resolution = color_resolution;
+    configuration.depth_mode       = depth_mode;
+
+    k4a::synthetic_source source( false );
+    source.start( configuration );
+
+    k4a::capture capture;
+    source.get_capture( &capture, std::chrono::milliseconds( K4A_WAIT_INFINITE ) );
+    return capture;
+}
+
+// Create YUV Image (NV12 or YUY2) with Pattern
+k4a::image create_yuv( const k4a_image_format_t format, const int32_t width, const int32_t height )
+{
+    const int32_t stride = ( format == K4A_IMAGE_FORMAT_COLOR_NV12 ) ? width : width * 2;
+    k4a::image image = k4a::image::create( format, width, height, stride );
+    for( size_t i = 0; i < image.get_size(); i++ ){
+        image.get_buffer()[i] = static_cast<uint8_t>( i * 7 );
+    }
+    return image;
+}
+
+// Benchmark k4a::get_mat() of Color Image (MJPG, BGRA32, NV12, or YUY2)
+void benchmark_get_mat_color( k4a::image& color_image, const std::string& mode )
+{
+    switch( color_image.get_format() ){
+        case K4A_IMAGE_FORMAT_COLOR_MJPG:
+            measure( "get_mat (MJPG)", mode, color_image.get_size(), [&](){ k4a::get_mat( color_image ); } );
+            measure( "get_mat (MJPG, 1/4, BGR)", mode, color_image.get_size(), [&](){ k4a::get_mat( color_image, k4a::decode_scale::quarter, false ); } );
+            break;
+        case K4A_IMAGE_FORMAT_COLOR_BGRA32:
+            measure( "get_mat (BGRA32, copy)", mode, color_image.get_size(), [&](){ k4a::get_mat( color_image ); } );
+            measure( "get_mat (BGRA32, shared)", mode, color_image.get_size(), [&](){ k4a::get_mat( color_image, false ); } );
+            break;
+        case K4A_IMAGE_FORMAT_COLOR_NV12:
+            measure( "get_mat (NV12)", mode, color_image.get_size(), [&](){ k4a::get_mat( color_image ); } );
+            break;
+        case K4A_IMAGE_FORMAT_COLOR_YUY2:
+            measure( "get_mat (YUY2)", mode, color_image.get_size(), [&](){ k4a::get_mat( color_image ); } );
+            break;
+        default:
+            break;
+    }
+}
+
+// Benchmark k4a::get_mat() of Depth, Infrared, and Point Cloud Images
+void benchmark_get_mat_depth( k4a::image& depth_image, k4a::image& ir_image, const k4a::calibration& calibration, const std::string& mode )
+{
+    measure( "get_mat (DEPTH16, copy)", mode, depth_image.get_size(), [&](){ k4a::get_mat( depth_image ); } );
+    measure( "get_mat (DEPTH16, shared)", mode, depth_image.get_size(), [&](){ k4a::get_mat( depth_image, false ); } );
+
+    if( ir_image.handle() ){
+        measure( "get_mat (IR16, copy)", mode, ir_image.get_size(), [&](){ k4a::get_mat( ir_image ); } );
+    }
+
+    k4a::transformation transformation( calibration );
+    k4a::frame_pool pool( calibration );
+    k4a::image xyz_image = pool.get_xyz_image( K4A_CALIBRATION_TYPE_DEPTH );
+    transformation.depth_image_to_point_cloud( depth_image, K4A_CALIBRATION_TYPE_DEPTH, &xyz_image );
+    measure( "get_mat (CUSTOM xyz)", mode, xyz_image.get_size(), [&](){ k4a::get_mat( xyz_image ); } );
+    measure( "get_mat (CUSTOM xyz, NaN)", mode, xyz_image.get_size(), [&](){ k4a::get_mat( xyz_image, true, true ); } );
+    transformation.destroy();
+}
+
+// Benchmark k4a::transformation between Depth Camera and Color Camera (color_image is BGRA32)
+void benchmark_transformation( k4a::image& depth_image, k4a::image& color_image, const k4a::calibration& calibration, const std::string& mode )
+{
+    k4a::transformation transformation( calibration );
+    k4a::frame_pool pool( calibration );
+
+    k4a::image transformed_depth_image = pool.get_transformed_depth_image();
+    measure( "depth_image_to_color_camera", mode, depth_image.get_size(), [&](){ transformation.depth_image_to_color_camera( depth_image, &transformed_depth_image ); } );
+
+    k4a::image transformed_color_image = pool.get_transformed_color_image();
+    measure( "color_image_to_depth_camera", mode, color_image.get_size(), [&](){ transformation.color_image_to_depth_camera( depth_image, color_image, &transformed_color_image ); } );
+
+    k4a::image xyz_image = pool.get_xyz_image( K4A_CALIBRATION_TYPE_COLOR );
+    measure( "depth_image_to_point_cloud (color)", mode, transformed_depth_image.get_size(), [&](){ transformation.depth_image_to_point_cloud( transformed_depth_image, K4A_CALIBRATION_TYPE_COLOR, &xyz_image ); } );
+
+    // Point Cloud with Table of Rays (Table is computed once out of measurement)
+    k4a::unprojection unprojection( calibration, K4A_CALIBRATION_TYPE_COLOR );
+    cv::Mat xyz;
+    measure( "unprojection (color, int16)", mode, transformed_depth_image.get_size(), [&](){ unprojection.compute( transformed_depth_image, xyz_image ); } );
+    measure( "unprojection (color, float32, NaN)", mode, transformed_depth_image.get_size(), [&](){ unprojection.compute( transformed_depth_image, xyz, true ); } );
+
+    // Point Cloud of Center Half ROI with Stride 2 (1/16 points)
+    const int32_t width = transformed_depth_image.get_width_pixels();
+    const int32_t height = transformed_depth_image.get_height_pixels();
+    unprojection.set_region( cv::Rect( width / 4, height / 4, width / 2, height / 2 ), 2 );
+    measure( "unprojection (color, roi, stride 2)", mode, transformed_depth_image.get_size() / 16, [&](){ unprojection.compute( transformed_depth_image, xyz, true ); } );
+
+    // Voxel Grid Downsampling of Full Point Cloud with Color (Hash tables are reused in every iteration)
+    unprojection.set_region( cv::Rect(), 1 );
+    unprojection.compute( transformed_depth_image, xyz, true );
+    const cv::Mat color = k4a::get_mat( color_image, false );
+    k4a::voxel_grid voxel_grid( 10.0f, k4a::voxel_grid::policy::centroid );
+    cv::Mat filtered_xyz, filtered_color;
+    measure( "voxel_grid (color, 10mm, centroid)", mode, xyz.total() * xyz.elemSize(), [&](){ voxel_grid.filter( xyz, color, filtered_xyz, filtered_color ); } );
+    voxel_grid.reset( 10.0f, k4a::voxel_grid::policy::first );
+    measure( "voxel_grid (color, 10mm, first)", mode, xyz.total() * xyz.elemSize(), [&](){ voxel_grid.filter( xyz, color, filtered_xyz, filtered_color ); } );
+
+    transformation.destroy();
+}
+
+// Benchmark Point Cloud in Depth Camera (It doesn't depend on color resolution)
+void benchmark_point_cloud( k4a::image& depth_image, const k4a::calibration& calibration, const std::string& mode )
+{
+    k4a::transformation transformation( calibration );
+    k4a::frame_pool pool( calibration );
+    k4a::image xyz_image = pool.get_xyz_image( K4A_CALIBRATION_TYPE_DEPTH );
+    measure( "depth_image_to_point_cloud (depth)", mode, depth_image.get_size(), [&](){ transformation.depth_image_to_point_cloud( depth_image, K4A_CALIBRATION_TYPE_DEPTH, &xyz_image ); } );
+    const k4a::unprojection unprojection( calibration, K4A_CALIBRATION_TYPE_DEPTH );
+    cv::Mat xyz;
+    measure( "unprojection (depth, float32, NaN)", mode, depth_image.get_size(), [&](){ unprojection.compute( depth_image, xyz, true ); } );
+    transformation.destroy();
+}
+
+// Benchmark Visualization in Samples (Colorization of Body Index Map, and Scaling of Depth)
+void benchmark_visualization( k4a::image& depth_image, const std::string& mode )
+{
+    // Same Colors and Lambda as index_map Sample
+    constexpr uint8_t background = 255; // K4ABT_BODY_INDEX_MAP_BACKGROUND
+    std::vector<cv::Vec3b> colors;
+    colors.push_back( cv::Vec3b( 255,   0,   0 ) );
+    colors.push_back( cv::Vec3b(   0, 255,   0 ) );
+    colors.push_back( cv::Vec3b(   0,   0, 255 ) );
+    colors.push_back( cv::Vec3b( 255, 255,   0 ) );
+    colors.push_back( cv::Vec3b(   0, 255, 255 ) );
+    colors.push_back( cv::Vec3b( 255,   0, 255 ) );
+
+    const cv::Mat depth = k4a::get_mat( depth_image );
+
+    // Body Index Map (Points closer than 1500mm are body 0, others are background)
+    cv::Mat body_index_map( depth.size(), CV_8UC1, cv::Scalar( background ) );
+    body_index_map.setTo( cv::Scalar( 0 ), ( depth > 0 ) & ( depth < 1500 ) );
+
+    measure( "colorize body index map (forEach)", mode, body_index_map.total(), [&](){
+        cv::Mat colorized_body_index_map = cv::Mat::zeros( body_index_map.size(), CV_8UC3 );
+        colorized_body_index_map.forEach<cv::Vec3b>(
+            [&]( cv::Vec3b& pixel, const int32_t* position ){
+                const uint32_t body_index = body_index_map.at<uint8_t>( position[0], position[1] );
+                if( body_index != background ){
+                    pixel = colors[body_index % colors.size()];
+                }
+            }
+        );
+    } );
+
+    measure( "scale depth (convertTo)", mode, depth.total() * depth.elemSize(), [&](){
+        cv::Mat scaled;
+        depth.convertTo( scaled, CV_8U, -255.0 / 5000.0, 255.0 );
+    } );
+}
+
+// Run Benchmarks with Synthetic Frames at Every Color Resolution and Depth Mode
+void benchmark_synthetic()
+{
+    // k4a::get_mat() per Format
+    for( const k4a_color_resolution_t color_resolution : k4a::sweep_color_resolutions ){
+        const std::string mode = k4a::to_string( color_resolution );
+
+        k4a::image mjpg_image = get_capture( K4A_IMAGE_FORMAT_COLOR_MJPG, color_resolution, K4A_DEPTH_MODE_OFF ).get_color_image();
+        benchmark_get_mat_color( mjpg_image, mode );
+
+        k4a::image bgra_image = get_capture( K4A_IMAGE_FORMAT_COLOR_BGRA32, color_resolution, K4A_DEPTH_MODE_OFF ).get_color_image();
+        benchmark_get_mat_color( bgra_image, mode );
+
+        const int32_t width = bgra_image.get_width_pixels();
+        const int32_t height = bgra_image.get_height_pixels();
+        k4a::image nv12_image = create_yuv( K4A_IMAGE_FORMAT_COLOR_NV12, width, height );
+        benchmark_get_mat_color( nv12_image, mode );
+        k4a::image yuy2_image = create_yuv( K4A_IMAGE_FORMAT_COLOR_YUY2, width, height );
+        benchmark_get_mat_color( yuy2_image, mode );
+    }
+
+    for( const k4a_depth_mode_t depth_mode : k4a::sweep_depth_modes ){
+        k4a::capture capture = get_capture( K4A_IMAGE_FORMAT_COLOR_BGRA32, K4A_COLOR_RESOLUTION_OFF, depth_mode );
+        k4a::image depth_image = capture.get_depth_image();
+        k4a::image ir_image = capture.get_ir_image();
+        benchmark_get_mat_depth( depth_image, ir_image, k4a::synthetic_source::create_calibration( depth_mode, K4A_COLOR_RESOLUTION_OFF ), k4a::to_string( depth_mode ) );
+    }
+
+    // k4a::transformation at Every Combination of Depth Mode and Color Resolution
+    k4a::sweep_synthetic_sources( [&]( k4a::capture_source& source, const std::string& name ){
+        k4a::capture capture;
+        source.get_capture( &capture, std::chrono::milliseconds( K4A_WAIT_INFINITE ) );
+        k4a::image depth_image = capture.get_depth_image();
+        k4a::image color_image = capture.get_color_image();
+        benchmark_transformation( depth_image, color_image, source.get_calibration(), name );
+    } );
+
+    // Point Cloud
+    for( const k4a_depth_mode_t depth_mode : k4a::sweep_depth_modes ){
+        k4a::image depth_image = get_capture( K4A_IMAGE_FORMAT_COLOR_BGRA32, K4A_COLOR_RESOLUTION_OFF, depth_mode ).get_depth_image();
+        benchmark_point_cloud( depth_image, k4a::synthetic_source::create_calibration( depth_mode, K4A_COLOR_RESOLUTION_OFF ), k4a::to_string( depth_mode ) );
+    }
+
+    // Visualization
+    for( const k4a_depth_mode_t depth_mode : k4a::sweep_depth_modes ){
+        k4a::image depth_image = get_capture( K4A_IMAGE_FORMAT_COLOR_BGRA32, K4A_COLOR_RESOLUTION_OFF, depth_mode ).get_depth_image();
+        benchmark_visualization( depth_image, k4a::to_string( depth_mode ) );
+    }
+}
+
+// Run Benchmarks with Recorded Frame (First capture that has depth image)
+void benchmark_recorded( const std::string& file )
+{
+    k4a::playback_source source( file );
+    const k4a::calibration calibration = source.get_calibration();
+
+    k4a::capture capture;
+    k4a::image depth_image;
+    while( source.get_capture( &capture, std::chrono::milliseconds( K4A_WAIT_INFINITE ) ) ){
+        depth_image = capture.get_depth_image();
+        if( depth_image.handle() ){
+            break;
+        }
+    }
+    if( !depth_image.handle() ){
+        throw k4a::error( "Failed to benchmark! (recording doesn't have depth image)" );
+    }
+    k4a::image color_image = capture.get_color_image();
+    k4a::image ir_image = capture.get_ir_image();
+
+    const std::string depth_mode_name = file + " " + k4a::to_string( calibration.depth_mode );
+    benchmark_get_mat_depth( depth_image, ir_image, calibration, depth_mode_name );
+
+    if( color_image.handle() ){
+        const std::string mode = file + " " + k4a::to_string( calibration.depth_mode ) + " " + k4a::to_string( calibration.color_resolution );
+        benchmark_get_mat_color( color_image, file + " " + k4a::to_string( calibration.color_resolution ) );
+
+        // Transformation Needs BGRA32 (Recorded color image is converted once out of measurement)
+        if( color_image.get_format() != K4A_IMAGE_FORMAT_COLOR_BGRA32 ){
+            cv::Mat color = k4a::get_mat( color_image );
+            if( color.type() != CV_8UC4 ){
+                cv::cvtColor( color, color, cv::COLOR_BGR2BGRA );
+            }
+            color_image = k4a::image::create( K4A_IMAGE_FORMAT_COLOR_BGRA32, color.cols, color.rows, color.cols * 4 );
+            for( int32_t y = 0; y < color.rows; y++ ){
+                std::memcpy( color_image.get_buffer() + y * color_image.get_stride_bytes(), color.ptr<uint8_t>( y ), static_cast<size_t>( color.cols ) * 4 );
+            }
+        }
+        benchmark_transformation( depth_image, color_image, calibration, mode );
+    }
+
+    benchmark_point_cloud( depth_image, calibration, depth_mode_name );
+    benchmark_visualization( depth_image, depth_mode_name );
+}
+
+int main( int argc, char* argv[] )
+{
+    // Parse Options
+    // hotpath [--min-time <seconds>] [file.mkv ...]
+    std::vector<std::string> files;
+    for( int32_t i = 1; i < argc; i++ ){
+        const std::string option = argv[i];
+        if( option == "--min-time" && i + 1 < argc ){
+            minimum_time = std::chrono::duration<double>( std::stod( argv[++i] ) );
+        }
+        else if( option.compare( 0, 2, "--" ) != 0 ){
+            files.push_back( option );
+        }
+        else{
+            std::cout << "usage: " << argv[0] << " [--min-time <seconds>] [file.mkv ...]" << std::endl;
+            return -1;
+        }
+    }
+
+    // Count Allocations of Buffers of cv::Mat
+    static counting_allocator allocator( cv::Mat::getDefaultAllocator() );
+    cv::Mat::setDefaultAllocator( &allocator );
+
+    try{
+        std::cout << "allocs/iter counts operator new and buffers of cv::Mat (malloc of C, e.g. in Azure Kinect SDK, is not counted)" << std::endl;
+        std::cout << std::setw( 40 ) << std::left << "benchmark"
+                  << std::setw( 26 ) << "mode" << std::right
+                  << std::setw( 14 ) << "ns/frame"
+                  << std::setw( 12 ) << "MB/s"
+                  << std::setw( 14 ) << "allocs/iter"
+                  << std::endl;
+
+        // Recorded Frames, or Synthetic Frames if File is not Given
+        for( const std::string& file : files ){
+            benchmark_recorded( file );
+        }
+        if( files.empty() ){
+            benchmark_synthetic();
+        }
+    }
+    catch( const k4a::error& error ){
+        std::cout << error.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,190 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <stdexcept>
+
+#include "pipeline.h"
+
+// Payload (Reference Counted Handle like k4a::capture)
+struct payload
+{
+    std::chrono::steady_clock::time_point timestamp;
+    std::shared_ptr<std::vector<uint8_t>> data;
+};
+
+// Result
+struct result
+{
+    uint64_t delivered = 0;
+    uint64_t dropped = 0;
+    double seconds = 0.0;
+    std::vector<double> latencies; // [us]
+};
+
+// Run Producer and Consumer
+// (rate is messages per second, 0 is unthrottled)
+template<typename push_function, typename pop_function, typename close_function>
+result run( const double rate, const uint64_t count, push_function push, pop_function pop, close_function close )
+{
+    result result;
+    result.latencies.reserve( static_cast<size_t>( count ) );
+
+    const std::shared_ptr<std::vector<uint8_t>> data = std::make_shared<std::vector<uint8_t>>( 64 );
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Consumer
+    std::thread consumer( [&](){
+        payload value;
+        while( pop( value ) ){
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            result.latencies.push_back( std::chrono::duration<double, std::micro>( now - value.timestamp ).count() );
+            result.delivered++;
+        }
+    } );
+
+    // Producer
+    const std::chrono::nanoseconds interval( rate > 0.0 ? static_cast<int64_t>( 1e9 / rate ) : 0 );
+    std::chrono::steady_clock::time_point next = start;
+    for( uint64_t i = 0; i < count; i++ ){
+        if( interval.count() > 0 ){
+            next += interval;
+            std::this_thread::sleep_until( next );
+        }
+
+        payload value;
+        value.timestamp = std::chrono::steady_clock::now();
+        value.data = data;
+        if( !push( value ) ){
+            result.dropped++;
+        }
+    }
+
+    close();
+    consumer.join();
+    result.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    return result;
+}
+
+// Mutex + Condition Variable Queue
+result run_bounded_queue( const double rate, const uint64_t count, const size_t capacity )
+{
+    k4a::bounded_queue<payload> queue( capacity, k4a::drop_policy::block );
+    return run( rate, count,
+        [&]( payload& value ){ return queue.push( std::move( value ) ); },
+        [&]( payload& value ){ return queue.pop( value ); },
+        [&](){ queue.close(); }
+    );
+}
+
+// Lock-Free SPSC Ring (Consumer waits with wait function while ring is empty)
+result run_spsc_ring( const double rate, const uint64_t count, const size_t capacity, std::function<void()> wait )
+{
+    k4a::spsc_ring<payload> ring( capacity );
+    std::atomic<bool> closed( false );
+    return run( rate, count,
+        [&]( payload& value ){
+            while( !ring.try_push( value ) ){
+                std::this_thread::yield();
+            }
+            return true;
+        },
+        [&]( payload& value ){
+            while( !ring.try_pop( value ) ){
+                if( closed.load( std::memory_order_acquire ) ){
+                    return ring.try_pop( value );
+                }
+                wait();
+            }
+            return true;
+        },
+        [&](){ closed.store( true, std::memory_order_release ); }
+    );
+}
+
+// Lock-Free SPSC Ring (Waiting thread spins, yields, and then parks on condition variable)
+result run_spsc_ring_park( const double rate, const uint64_t count, const size_t capacity )
+{
+    k4a::spsc_ring<payload> ring( capacity, k4a::drop_policy::block );
+    return run( rate, count,
+        [&]( payload& value ){ return ring.push( value ); },
+        [&]( payload& value ){ return ring.pop( value ); },
+        [&](){ ring.close(); }
+    );
+}
+
+// Print Result
+void print( const std::string& name, const double rate, result result )
+{
+    std::sort( result.latencies.begin(), result.latencies.end() );
+    auto percentile = [&]( const double p ){
+        if( result.latencies.empty() ){
+            return 0.0;
+        }
+        const size_t index = std::min( result.latencies.size() - 1, static_cast<size_t>( p * result.latencies.size() ) );
+        return result.latencies[index];
+    };
+
+    std::cout << std::setw( 10 ) << ( rate > 0.0 ? std::to_string( static_cast<int32_t>( rate ) ) + " Hz" : std::string( "max" ) )
+              << std::setw( 22 ) << name
+              << std::setw( 12 ) << result.delivered
+              << std::setw( 10 ) << result.dropped
+              << std::setw( 14 ) << std::fixed << std::setprecision( 0 ) << result.delivered / result.seconds
+              << std::setw( 12 ) << std::setprecision( 2 ) << percentile( 0.50 )
+              << std::setw( 12 ) << percentile( 0.99 )
+              << std::setw( 12 ) << percentile( 1.00 )
+              << std::endl;
+}
+
+int main( int argc, char* argv[] )
+{
+    // Parse Options
+    // queue [--capacity <N>] [--duration <seconds>]
+    size_t capacity = 4;
+    double duration = 2.0; // [s]
+    try{
+        for( int32_t i = 1; i < argc; i++ ){
+            const std::string option = argv[i];
+            if( option == "--capacity" && i + 1 < argc ){
+                capacity = std::stoul( argv[++i] );
+            }
+            else if( option == "--duration" && i + 1 < argc ){
+                duration = std::stod( argv[++i] );
+            }
+            else{
+                throw std::invalid_argument( option );
+            }
+        }
+    }
+    catch( const std::exception& ){
+        std::cout << "usage: " << argv[0] << " [--capacity <N>] [--duration <seconds>]" << std::endl;
+        return -1;
+    }
+
+    std::cout << std::setw( 10 ) << "rate"
+              << std::setw( 22 ) << "queue"
+              << std::setw( 12 ) << "delivered"
+              << std::setw( 10 ) << "dropped"
+              << std::setw( 14 ) << "msg/s"
+              << std::setw( 12 ) << "p50 [us]"
+              << std::setw( 12 ) << "p99 [us]"
+              << std::setw( 12 ) << "max [us]"
+              << std::endl;
+
+    const std::vector<double> rates = { 30.0, 60.0, 1000.0, 0.0 };
+    for( const double rate : rates ){
+        const uint64_t count = ( rate > 0.0 ) ? static_cast<uint64_t>( rate * duration ) : 1000000;
+        print( "mutex + condvar", rate, run_bounded_queue( rate, count, capacity ) );
+        print( "spsc ring (yield)", rate, run_spsc_ring( rate, count, capacity, [](){ std::this_thread::yield(); } ) );
+        print( "spsc ring (park)", rate, run_spsc_ring_park( rate, count, capacity ) );
+        print( "spsc ring (sleep 1ms)", rate, run_spsc_ring( rate, ( rate > 0.0 ) ? count : 10000, capacity, [](){ std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) ); } ) );
+    }
+
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+
+#include "util.h"
+#include "pool.h"
+#include "source.h"
+#include "reprojection.h"
+#include "sweep.h"
+
+// Comparison of CPU Reprojection with SDK
+struct comparison
+{
+    uint64_t frames = 0;
+    uint64_t both = 0;     // Pixels that are valid in both
+    uint64_t sdk_only = 0; // Pixels that are valid only in SDK
+    uint64_t cpu_only = 0; // Pixels that are valid only in CPU
+    uint64_t within = 0;   // Pixels that are valid in both, and difference is within tolerance
+    double sum_difference = 0.0;
+    uint16_t max_difference = 0;
+    std::chrono::duration<double> sdk_time;
+    std::chrono::duration<double> cpu_time;
+};
+
+// Tolerance of Difference (Ratio to depth)
+static double tolerance = 0.01;
+
+// Compare Transformed Depth Images
+void compare( const k4a::image& expected, const k4a::image& actual, comparison& result )
+{
+    const int32_t width = expected.get_width_pixels();
+    const int32_t height = expected.get_height_pixels();
+    for( int32_t y = 0; y < height; y++ ){
+        const uint16_t* e = reinterpret_cast<const uint16_t*>( expected.get_buffer() + static_cast<size_t>( y ) * expected.get_stride_bytes() );
+        const uint16_t* a = reinterpret_cast<const uint16_t*>( actual.get_buffer() + static_cast<size_t>( y ) * actual.get_stride_bytes() );
+        for( int32_t x = 0; x < width; x++ ){
+            if( e[x] == 0 && a[x] == 0 ){
+                continue;
+            }
+            if( a[x] == 0 ){
+                result.sdk_only++;
+                continue;
+            }
+            if( e[x] == 0 ){
+                result.cpu_only++;
+                continue;
+            }
+
+            const uint16_t difference = static_cast<uint16_t>( std::abs( static_cast<int32_t>( e[x] ) - static_cast<int32_t>( a[x] ) ) );
+            result.both++;
+            result.sum_difference += difference;
+            result.max_difference = std::max( result.max_difference, difference );
+            if( difference <= e[x] * tolerance ){
+                result.within++;
+            }
+        }
+    }
+}
+
+// Validate CPU Reprojection with Captures of Source, and Print Result (Return false if it doesn't match SDK)
+bool validate( k4a::capture_source& source, const std::string& name, const uint64_t frames )
+{
+    const k4a::calibration calibration = source.get_calibration();
+    k4a::transformation transformation( calibration );
+    k4a::reprojection reprojection( calibration );
+    k4a::frame_pool pool( calibration );
+    k4a::image expected = pool.get_transformed_depth_image();
+    k4a::image actual = k4a::image::create( K4A_IMAGE_FORMAT_DEPTH16, expected.get_width_pixels(), expected.get_height_pixels(), expected.get_stride_bytes() );
+
+    comparison result;
+    k4a::capture capture;
+    while( result.frames < frames && source.get_capture( &capture, std::chrono::milliseconds( K4A_WAIT_INFINITE ) ) ){
+        const k4a::image depth_image = capture.get_depth_image();
+        if( !depth_image.handle() ){
+            continue;
+        }
+
+        // SDK
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        transformation.depth_image_to_color_camera( depth_image, &expected );
+        result.sdk_time += std::chrono::steady_clock::now() - start;
+
+        // CPU
+        start = std::chrono::steady_clock::now();
+        reprojection.depth_image_to_color_camera( depth_image, &actual );
+        result.cpu_time += std::chrono::steady_clock::now() - start;
+
+        compare( expected, actual, result );
+        result.frames++;
+        capture.reset();
+    }
+    transformation.destroy();
+
+    if( result.frames == 0 ){
+        std::cout << std::setw( 28 ) << std::left << name << "no depth frames" << std::endl;
+        return false;
+    }
+
+    // Coverage is intersection over union of valid pixels
+    const double valid = static_cast<double>( result.both + result.sdk_only + result.cpu_only );
+    const double coverage = ( valid > 0 ) ? result.both / valid : 1.0;
+    const double within = ( result.both > 0 ) ? static_cast<double>( result.within ) / result.both : 1.0;
+    const double mean = ( result.both > 0 ) ? result.sum_difference / result.both : 0.0;
+    const double sdk_ms = result.sdk_time.count() * 1000.0 / result.frames;
+    const double cpu_ms = result.cpu_time.count() * 1000.0 / result.frames;
+
+    // Pass if most of pixels agree (Edges of surfaces are splatted differently)
+    constexpr double threshold = 0.95;
+    const bool passed = coverage >= threshold && within >= threshold;
+
+    std::cout << std::setw( 28 ) << std::left << name << std::right
+              << std::setw( 8 ) << result.frames << std::fixed << std::setprecision( 2 )
+              << std::setw( 10 ) << sdk_ms
+              << std::setw( 10 ) << cpu_ms
+              << std::setw( 10 ) << coverage * 100.0
+              << std::setw( 10 ) << within * 100.0
+              << std::setw( 10 ) << mean
+              << std::setw( 8 ) << result.max_difference
+              << std::setw( 8 ) << ( passed ? "ok" : "FAILED" ) << std::endl;
+    return passed;
+}
+
+int main( int argc, char* argv[] )
+{
+    // Parse Options
+    // reprojection [--frames <N>] [--tolerance <ratio>] [file.mkv ...]
+    // (Synthetic frames of every depth mode and color resolution are used if no file is specified.)
+    uint64_t frames = 30;
+    std::vector<std::string> files;
+    for( int32_t i = 1; i < argc; i++ ){
+        const std::string option = argv[i];
+        if( option == "--frames" && i + 1 < argc ){
+            frames = std::stoull( argv[++i] );
+        }
+        else if( option == "--tolerance" && i + 1 < argc ){
+            tolerance = std::stod( argv[++i] );
+        }
+        else{
+            files.push_back( option );
+        }
+    }
+
+    bool passed = true;
+    try{
+        std::cout << std::setw( 28 ) << std::left << "source" << std::right
+                  << std::setw( 8 ) << "frames"
+                  << std::setw( 10 ) << "sdk ms"
+                  << std::setw( 10 ) << "cpu ms"
+                  << std::setw( 10 ) << "cover %"
+                  << std::setw( 10 ) << "match %"
+                  << std::setw( 10 ) << "mean mm"
+                  << std::setw( 8 ) << "max mm"
+                  << std::setw( 8 ) << "result" << std::endl;
+
+        // Recorded Frames
+        for( const std::string& file : files ){
+            k4a::playback_source source( file );
+            passed &= validate( source, file, frames );
+        }
+
+        // Synthetic Frames
+        if( files.empty() ){
+            k4a::sweep_synthetic_sources( [&]( k4a::capture_source& source, const std::string& name ){
+                passed &= validate( source, name, frames );
+            } );
+        }
+    }
+    catch( const k4a::error& error ){
+        std::cout << error.what() << std::endl;
+        return -1;
+    }
+
+    return passed ? 0 : 1;
+}
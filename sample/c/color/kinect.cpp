@@ -147,8 +147,8 @@ inline void kinect::draw_color()
         return;
     }
 
-    // Get cv::Mat from k4a_image_t
-    color = k4a_get_mat( color_image );
+    // Get cv::Mat from k4a_image_t (Shared without Copy)
+    color = k4a_get_mat( color_image, false );
 
     // Release Color Image Handle
     k4a_image_release( color_image );
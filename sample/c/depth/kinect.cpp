@@ -147,8 +147,8 @@ inline void kinect::draw_depth()
         return;
     }
 
-    // Get cv::Mat from k4a_image_t
-    depth = k4a_get_mat( depth_image );
+    // Get cv::Mat from k4a_image_t (Shared without Copy)
+    depth = k4a_get_mat( depth_image, false );
 
     // Release Depth Image Handle
     k4a_image_release( depth_image );
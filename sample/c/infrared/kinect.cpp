@@ -147,8 +147,8 @@ inline void kinect::draw_infrared()
         return;
     }
 
-    // Get cv::Mat from k4a_image_t
-    infrared = k4a_get_mat( infrared_image );
+    // Get cv::Mat from k4a_image_t (Shared without Copy)
+    infrared = k4a_get_mat( infrared_image, false );
 
     // Release Infrared Image Handle
     k4a_image_release( infrared_image );
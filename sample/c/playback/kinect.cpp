@@ -21,7 +21,9 @@ kinect::kinect( const uint32_t index )
       color_image( nullptr ),
       depth_image( nullptr ),
       transformed_color_image( nullptr ),
-      transformed_depth_image( nullptr )
+      transformed_depth_image( nullptr ),
+      pooled_transformed_color_image( nullptr ),
+      pooled_transformed_depth_image( nullptr )
 {
     // Initialize
     initialize();
@@ -35,7 +37,9 @@ kinect::kinect( const filesystem::path path )
       color_image( nullptr ),
       depth_image( nullptr ),
       transformed_color_image( nullptr ),
-      transformed_depth_image( nullptr )
+      transformed_depth_image( nullptr ),
+      pooled_transformed_color_image( nullptr ),
+      pooled_transformed_depth_image( nullptr )
 {
     // Initialize
     initialize();
@@ -58,6 +62,9 @@ void kinect::initialize()
         // Initialize Playback
         initialize_playback();
     }
+
+    // Initialize Pool
+    initialize_pool();
 }
 
 // Initialize Sensor
@@ -105,9 +112,32 @@ inline void kinect::initialize_playback()
     transformation = k4a_transformation_create( &calibration );
 }
 
+// Initialize Pool
+inline void kinect::initialize_pool()
+{
+    // NOTE: Transformed images are allocated once, and reused in every frame.
+    int32_t stride_bytes;
+
+    // Create Color Image in Depth Camera Geometry
+    const int32_t depth_width  = calibration.depth_camera_calibration.resolution_width;
+    const int32_t depth_height = calibration.depth_camera_calibration.resolution_height;
+    stride_bytes = depth_width * 4 * static_cast<int32_t>( sizeof( uint8_t ) );
+    K4A_RESULT_CHECK( k4a_image_create( k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_BGRA32, depth_width, depth_height, stride_bytes, &pooled_transformed_color_image ) );
+
+    // Create Depth Image in Color Camera Geometry
+    const int32_t color_width  = calibration.color_camera_calibration.resolution_width;
+    const int32_t color_height = calibration.color_camera_calibration.resolution_height;
+    stride_bytes = color_width * static_cast<int32_t>( sizeof( uint16_t ) );
+    K4A_RESULT_CHECK( k4a_image_create( k4a_image_format_t::K4A_IMAGE_FORMAT_DEPTH16, color_width, color_height, stride_bytes, &pooled_transformed_depth_image ) );
+}
+
 // Finalize
 void kinect::finalize()
 {
+    // Release Pool of Transformed Images
+    k4a_image_release( pooled_transformed_color_image );
+    k4a_image_release( pooled_transformed_depth_image );
+
     // Destroy Transformation
     k4a_transformation_destroy( transformation );
 
@@ -223,14 +253,10 @@ inline void kinect::update_transformation()
         return;
     }
 
-    int32_t stride_bytes;
-
     if( playback_file.empty() ){
         // Transform Color Image to Depth Camera
-        const int32_t depth_width = k4a_image_get_width_pixels( depth_image );
-        const int32_t depth_height = k4a_image_get_height_pixels( depth_image );
-        stride_bytes = depth_width * 4 * static_cast<int32_t>( sizeof( uint8_t ) );
-        K4A_RESULT_CHECK( k4a_image_create( k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_BGRA32, depth_width, depth_height, stride_bytes, &transformed_color_image ) );
+        transformed_color_image = pooled_transformed_color_image;
+        k4a_image_reference( transformed_color_image );
         K4A_RESULT_CHECK( k4a_transformation_color_image_to_depth_camera( transformation, depth_image, color_image, transformed_color_image ) );
     }
     else{
@@ -240,18 +266,14 @@ inline void kinect::update_transformation()
         K4A_RESULT_CHECK( k4a_image_create_from_buffer( K4A_IMAGE_FORMAT_COLOR_BGRA32, color.cols, color.rows, static_cast<int32_t>( color.step ), &color.data[0], static_cast<int32_t>( color.total() * color.elemSize() ), nullptr, nullptr, &color_image ) );
 
         // Transform Color Image to Depth Camera
-        const int32_t depth_width = k4a_image_get_width_pixels( depth_image );
-        const int32_t depth_height = k4a_image_get_height_pixels( depth_image );
-        stride_bytes = depth_width * 4 * static_cast<int32_t>( sizeof( uint8_t ) );
-        K4A_RESULT_CHECK( k4a_image_create( k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_BGRA32, depth_width, depth_height, stride_bytes, &transformed_color_image ) );
+        transformed_color_image = pooled_transformed_color_image;
+        k4a_image_reference( transformed_color_image );
         K4A_RESULT_CHECK( k4a_transformation_color_image_to_depth_camera( transformation, depth_image, color_image, transformed_color_image ) );
     }
 
     // Transform Depth Image to Color Camera
-    const int32_t color_width = k4a_image_get_width_pixels( color_image );
-    const int32_t color_height = k4a_image_get_height_pixels( color_image );
-    stride_bytes = color_width * static_cast<int32_t>( sizeof( uint16_t ) );
-    K4A_RESULT_CHECK( k4a_image_create( k4a_image_format_t::K4A_IMAGE_FORMAT_DEPTH16, color_width, color_height, stride_bytes, &transformed_depth_image ) );
+    transformed_depth_image = pooled_transformed_depth_image;
+    k4a_image_reference( transformed_depth_image );
     K4A_RESULT_CHECK( k4a_transformation_depth_image_to_color_camera( transformation, depth_image, transformed_depth_image ) );
 }
 
@@ -44,6 +44,10 @@ private:
     cv::Mat transformed_color;
     cv::Mat transformed_depth;
 
+    // Pool of Transformed Images
+    k4a_image_t pooled_transformed_color_image;
+    k4a_image_t pooled_transformed_depth_image;
+
 public:
     // Constructor
     kinect( const uint32_t index = K4A_DEVICE_DEFAULT );
@@ -76,6 +80,9 @@ private:
     // Initialize Playback
     void initialize_playback();
 
+    // Initialize Pool
+    void initialize_pool();
+
     // Finalize
     void finalize();
 
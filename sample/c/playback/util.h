@@ -3,6 +3,22 @@
 
  cv::Mat mat = k4a::get_mat( image );
 
+ If deep_copy is false, cv::Mat shares the buffer of k4a::image without copy.
+ The k4a::image is kept alive until the last cv::Mat that refers to it is released,
+ so cv::Mat can be used after the k4a::image handle is reset.
+
+ cv::Mat mat = k4a::get_mat( image, false );
+
+ Point cloud (K4A_IMAGE_FORMAT_CUSTOM) is converted to CV_32FC3 with SIMD (AVX2/SSE4.1) if it is available.
+ If invalid_as_nan is true, invalid points (0,0,0) are converted to NaN (it is skipped in cv::viz::WCloud).
+
+ cv::Mat xyz = k4a::get_mat( xyz_image, true, true );
+
+ Motion JPEG (K4A_IMAGE_FORMAT_COLOR_MJPG) can be decoded at reduced resolution (1/2, 1/4, 1/8) using JPEG DCT scaling.
+ If bgra is false, decoded image is returned in BGR without expansion to BGRA.
+
+ cv::Mat color = k4a::get_mat( color_image, k4a::decode_scale::quarter, false );
+
  Copyright (c) 2019 Tsukasa Sugiura <t.sugiura0204@gmail.com>
  Licensed under the MIT license.
 
@@ -30,14 +46,235 @@
 
 #include <vector>
 #include <limits>
+#include <cassert>
 
 #include <k4a/k4a.h>
 #include <k4a/k4a.hpp>
 #include <opencv2/opencv.hpp>
 
+#if defined( __x86_64__ ) || defined( __i386__ ) || defined( _M_X64 ) || defined( _M_IX86 )
+#define __UTIL_X86__
+#include <immintrin.h>
+#if defined( _MSC_VER ) && !defined( __clang__ )
+#define __UTIL_TARGET__( name )
+#else
+#define __UTIL_TARGET__( name ) __attribute__(( target( name ) ))
+#endif
+#endif
+
 namespace k4a
 {
-    cv::Mat get_mat( k4a::image& src, bool deep_copy = true )
+    // Allocator for cv::Mat that shares the buffer of k4a::image
+    class image_allocator : public cv::MatAllocator
+    {
+    public:
+        #if ( CV_VERSION_MAJOR * 10000 + CV_VERSION_MINOR * 100 + CV_VERSION_REVISION ) < 40101
+        using access_flag = int;
+        #else
+        using access_flag = cv::AccessFlag;
+        #endif
+
+        // Allocate cv::UMatData that refers the buffer of k4a::image
+        cv::UMatData* allocate( k4a::image& image ) const
+        {
+            // Add Reference to Image Handle (Released in deallocate())
+            k4a_image_t handle = image.handle();
+            k4a_image_reference( handle );
+
+            cv::UMatData* u = new cv::UMatData( this );
+            u->data = u->origdata = image.get_buffer();
+            u->size = image.get_size();
+            u->userdata = handle;
+            return u;
+        }
+
+        // Allocate New Buffer (e.g. cv::Mat::create()) with Standard Allocator
+        cv::UMatData* allocate( int dims, const int* sizes, int type, void* data, size_t* step, access_flag flags, cv::UMatUsageFlags usage_flags ) const CV_OVERRIDE
+        {
+            return cv::Mat::getStdAllocator()->allocate( dims, sizes, type, data, step, flags, usage_flags );
+        }
+
+        bool allocate( cv::UMatData* u, access_flag flags, cv::UMatUsageFlags usage_flags ) const CV_OVERRIDE
+        {
+            return cv::Mat::getStdAllocator()->allocate( u, flags, usage_flags );
+        }
+
+        // Release Image Handle when Last cv::Mat is Released
+        void deallocate( cv::UMatData* u ) const CV_OVERRIDE
+        {
+            if( !u ){
+                return;
+            }
+
+            CV_Assert( u->urefcount >= 0 );
+            CV_Assert( u->refcount >= 0 );
+            if( u->refcount == 0 ){
+                k4a_image_release( reinterpret_cast<k4a_image_t>( u->userdata ) );
+                delete u;
+            }
+        }
+    };
+
+    image_allocator* get_image_allocator()
+    {
+        static image_allocator allocator;
+        return &allocator;
+    }
+
+    cv::Mat wrap_mat( k4a::image& src, const int32_t rows, const int32_t cols, const int32_t type, bool deep_copy = true )
+    {
+        cv::Mat mat = cv::Mat( rows, cols, type, src.get_buffer(), static_cast<size_t>( src.get_stride_bytes() ) );
+        if( deep_copy ){
+            return mat.clone();
+        }
+
+        // Share Buffer with k4a::image (Reference Counted)
+        mat.u = get_image_allocator()->allocate( src );
+        mat.addref();
+        return mat;
+    }
+
+    // Convert Points (int16x3) to Points (float32x3)
+    void convert_points_scalar( const int16_t* src, float* dst, const int32_t count, bool invalid_as_nan )
+    {
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        for( int32_t i = 0; i < count; i++ ){
+            const int16_t* point = src + i * 3;
+            float* result = dst + i * 3;
+            if( invalid_as_nan && point[2] == 0 ){
+                result[0] = result[1] = result[2] = nan;
+                continue;
+            }
+            result[0] = static_cast<float>( point[0] );
+            result[1] = static_cast<float>( point[1] );
+            result[2] = static_cast<float>( point[2] );
+        }
+    }
+
+    #ifdef __UTIL_X86__
+    // Replace Invalid Points (z == 0) in Block to NaN
+    inline void replace_invalid_points( const int16_t* src, float* dst, const int32_t count )
+    {
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        for( int32_t i = 0; i < count; i++ ){
+            if( src[i * 3 + 2] == 0 ){
+                dst[i * 3 + 0] = dst[i * 3 + 1] = dst[i * 3 + 2] = nan;
+            }
+        }
+    }
+
+    __UTIL_TARGET__( "sse4.1" )
+    void convert_points_sse41( const int16_t* src, float* dst, const int32_t count, bool invalid_as_nan )
+    {
+        // 8 points (24 values) per block
+        constexpr int32_t block = 8;
+        int32_t i = 0;
+        for( ; i + block <= count; i += block ){
+            const int16_t* s = src + i * 3;
+            float* d = dst + i * 3;
+            for( int32_t j = 0; j < 24; j += 8 ){
+                const __m128i value = _mm_loadu_si128( reinterpret_cast<const __m128i*>( s + j ) );
+                _mm_storeu_ps( d + j + 0, _mm_cvtepi32_ps( _mm_cvtepi16_epi32( value ) ) );
+                _mm_storeu_ps( d + j + 4, _mm_cvtepi32_ps( _mm_cvtepi16_epi32( _mm_srli_si128( value, 8 ) ) ) );
+            }
+            if( invalid_as_nan ){
+                replace_invalid_points( s, d, block );
+            }
+        }
+        convert_points_scalar( src + i * 3, dst + i * 3, count - i, invalid_as_nan );
+    }
+
+    __UTIL_TARGET__( "avx2" )
+    void convert_points_avx2( const int16_t* src, float* dst, const int32_t count, bool invalid_as_nan )
+    {
+        // 8 points (24 values) per block
+        constexpr int32_t block = 8;
+        int32_t i = 0;
+        for( ; i + block <= count; i += block ){
+            const int16_t* s = src + i * 3;
+            float* d = dst + i * 3;
+            for( int32_t j = 0; j < 24; j += 8 ){
+                const __m128i value = _mm_loadu_si128( reinterpret_cast<const __m128i*>( s + j ) );
+                _mm256_storeu_ps( d + j, _mm256_cvtepi32_ps( _mm256_cvtepi16_epi32( value ) ) );
+            }
+            if( invalid_as_nan ){
+                replace_invalid_points( s, d, block );
+            }
+        }
+        convert_points_scalar( src + i * 3, dst + i * 3, count - i, invalid_as_nan );
+    }
+    #endif
+
+    // Convert Point Cloud Image (K4A_IMAGE_FORMAT_CUSTOM) to cv::Mat (CV_32FC3)
+    void convert_point_cloud( k4a::image& src, cv::Mat& dst, bool invalid_as_nan = false )
+    {
+        assert( dst.type() == CV_32FC3 );
+        assert( dst.rows == src.get_height_pixels() && dst.cols == src.get_width_pixels() );
+
+        // Select Kernel at Runtime
+        void ( *convert_points )( const int16_t*, float*, const int32_t, bool ) = convert_points_scalar;
+        #ifdef __UTIL_X86__
+        if( cv::checkHardwareSupport( CV_CPU_AVX2 ) ){
+            convert_points = convert_points_avx2;
+        }
+        else if( cv::checkHardwareSupport( CV_CPU_SSE4_1 ) ){
+            convert_points = convert_points_sse41;
+        }
+        #endif
+
+        const uint8_t* buffer = src.get_buffer();
+        const int32_t stride = src.get_stride_bytes();
+        for( int32_t y = 0; y < dst.rows; y++ ){
+            const int16_t* points = reinterpret_cast<const int16_t*>( buffer + static_cast<size_t>( y ) * stride );
+            convert_points( points, dst.ptr<float>( y ), dst.cols, invalid_as_nan );
+        }
+    }
+
+    // Scale for Decoding Motion JPEG
+    enum class decode_scale
+    {
+        full    = 1,
+        half    = 2,
+        quarter = 4,
+        eighth  = 8
+    };
+
+    cv::Mat decode_mjpg( k4a::image& src, const decode_scale scale = decode_scale::full, bool bgra = true )
+    {
+        assert( src.get_format() == k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_MJPG );
+
+        // NOTE: compressed buffer is wrapped without copy, because cv::imdecode doesn't modify it.
+        const cv::Mat buffer( 1, static_cast<int32_t>( src.get_size() ), CV_8UC1, src.get_buffer() );
+
+        int32_t flags = cv::IMREAD_COLOR;
+        switch( scale )
+        {
+            case decode_scale::half:
+                flags = cv::IMREAD_REDUCED_COLOR_2;
+                break;
+            case decode_scale::quarter:
+                flags = cv::IMREAD_REDUCED_COLOR_4;
+                break;
+            case decode_scale::eighth:
+                flags = cv::IMREAD_REDUCED_COLOR_8;
+                break;
+            default:
+                break;
+        }
+
+        cv::Mat mat = cv::imdecode( buffer, flags );
+        if( mat.empty() ){
+            throw k4a::error( "Failed to decode motion jpeg!" );
+        }
+
+        if( bgra ){
+            cv::cvtColor( mat, mat, cv::COLOR_BGR2BGRA );
+        }
+
+        return mat;
+    }
+
+    cv::Mat get_mat( k4a::image& src, bool deep_copy = true, bool invalid_as_nan = false )
     {
         assert( src.get_size() != 0 );
 
@@ -51,52 +288,43 @@ namespace k4a
             case k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_MJPG:
             {
                 // NOTE: this is slower than other formats.
-                std::vector<uint8_t> buffer( src.get_buffer(), src.get_buffer() + src.get_size() );
-                mat = cv::imdecode( buffer, cv::IMREAD_ANYCOLOR );
-                cv::cvtColor( mat, mat, cv::COLOR_BGR2BGRA );
+                mat = decode_mjpg( src );
                 break;
             }
             case k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_NV12:
             {
-                cv::Mat nv12 = cv::Mat( height + height / 2, width, CV_8UC1, src.get_buffer() ).clone();
+                // NOTE: source buffer is read only, it doesn't need to copy before convert.
+                const cv::Mat nv12 = cv::Mat( height + height / 2, width, CV_8UC1, src.get_buffer(), static_cast<size_t>( src.get_stride_bytes() ) );
                 cv::cvtColor( nv12, mat, cv::COLOR_YUV2BGRA_NV12 );
                 break;
             }
             case k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_YUY2:
             {
-                cv::Mat yuy2 = cv::Mat( height, width, CV_8UC2, src.get_buffer() ).clone();
+                const cv::Mat yuy2 = cv::Mat( height, width, CV_8UC2, src.get_buffer(), static_cast<size_t>( src.get_stride_bytes() ) );
                 cv::cvtColor( yuy2, mat, cv::COLOR_YUV2BGRA_YUY2 );
                 break;
             }
             case k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_BGRA32:
             {
-                mat = deep_copy ? cv::Mat( height, width, CV_8UC4, src.get_buffer() ).clone()
-                                : cv::Mat( height, width, CV_8UC4, src.get_buffer() );
+                mat = wrap_mat( src, height, width, CV_8UC4, deep_copy );
                 break;
             }
             case k4a_image_format_t::K4A_IMAGE_FORMAT_DEPTH16:
             case k4a_image_format_t::K4A_IMAGE_FORMAT_IR16:
             {
-                mat = deep_copy ? cv::Mat( height, width, CV_16UC1, reinterpret_cast<uint16_t*>( src.get_buffer() ) ).clone()
-                                : cv::Mat( height, width, CV_16UC1, reinterpret_cast<uint16_t*>( src.get_buffer() ) );
+                mat = wrap_mat( src, height, width, CV_16UC1, deep_copy );
                 break;
             }
             case k4a_image_format_t::K4A_IMAGE_FORMAT_CUSTOM8:
             {
-                mat = cv::Mat( height, width, CV_8UC1, src.get_buffer() ).clone();
+                mat = wrap_mat( src, height, width, CV_8UC1, deep_copy );
                 break;
             }
             case k4a_image_format_t::K4A_IMAGE_FORMAT_CUSTOM:
             {
                 // NOTE: This is opencv_viz module format (cv::viz::WCloud).
-                const int16_t* buffer = reinterpret_cast<int16_t*>( src.get_buffer() );
-                mat = cv::Mat( height, width, CV_32FC3, cv::Vec3f::all( std::numeric_limits<float>::quiet_NaN() ) );
-                mat.forEach<cv::Vec3f>(
-                    [&]( cv::Vec3f& point, const int32_t* position ){
-                        const int32_t index = ( position[0] * width + position[1] ) * 3;
-                        point = cv::Vec3f( buffer[index + 0], buffer[index + 1], buffer[index + 2] );
-                    }
-                );
+                mat = cv::Mat( height, width, CV_32FC3 );
+                convert_point_cloud( src, mat, invalid_as_nan );
                 break;
             }
             default:
@@ -106,13 +334,41 @@ namespace k4a
 
         return mat;
     }
+
+    // Get cv::Mat with Reduced Resolution
+    // (Motion JPEG is decoded at reduced resolution, other formats are converted at full resolution and resized.)
+    cv::Mat get_mat( k4a::image& src, const decode_scale scale, bool bgra = true )
+    {
+        if( src.get_format() == k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_MJPG ){
+            return decode_mjpg( src, scale, bgra );
+        }
+
+        cv::Mat mat = get_mat( src );
+        if( scale != decode_scale::full ){
+            const double factor = 1.0 / static_cast<double>( scale );
+            cv::resize( mat, mat, cv::Size(), factor, factor, cv::INTER_AREA );
+        }
+
+        if( !bgra && mat.type() == CV_8UC4 ){
+            cv::cvtColor( mat, mat, cv::COLOR_BGRA2BGR );
+        }
+
+        return mat;
+    }
+}
+
+cv::Mat k4a_get_mat( k4a_image_t& src, bool deep_copy = true, bool invalid_as_nan = false )
+{
+    k4a_image_reference( src );
+    k4a::image img = k4a::image( src );
+    return k4a::get_mat( img, deep_copy, invalid_as_nan );
 }
 
-cv::Mat k4a_get_mat( k4a_image_t& src, bool deep_copy = true )
+cv::Mat k4a_get_mat( k4a_image_t& src, const k4a::decode_scale scale, bool bgra = true )
 {
     k4a_image_reference( src );
     k4a::image img = k4a::image( src );
-    return k4a::get_mat( img, deep_copy );
+    return k4a::get_mat( img, scale, bgra );
 }
 
 #endif // __UTIL__
\ No newline at end of file
@@ -21,7 +21,9 @@ kinect::kinect( const uint32_t index )
       color_image( nullptr ),
       depth_image( nullptr ),
       transformed_depth_image( nullptr ),
-      xyz_image( nullptr )
+      xyz_image( nullptr ),
+      pooled_transformed_depth_image( nullptr ),
+      pooled_xyz_image( nullptr )
 {
     // Initialize
     initialize();
@@ -39,6 +41,9 @@ void kinect::initialize()
     // Initialize Sensor
     initialize_sensor();
 
+    // Initialize Pool
+    initialize_pool();
+
     // Initialize Viewer
     initialize_viewer();
 }
@@ -71,6 +76,23 @@ inline void kinect::initialize_sensor()
     transformation = k4a_transformation_create( &calibration );
 }
 
+// Initialize Pool
+inline void kinect::initialize_pool()
+{
+    // NOTE: Transformed images are allocated once, and reused in every frame.
+    int32_t stride_bytes;
+
+    // Create Depth Image in Color Camera Geometry
+    const int32_t color_width  = calibration.color_camera_calibration.resolution_width;
+    const int32_t color_height = calibration.color_camera_calibration.resolution_height;
+    stride_bytes = color_width * static_cast<int32_t>( sizeof( uint16_t ) );
+    K4A_RESULT_CHECK( k4a_image_create( k4a_image_format_t::K4A_IMAGE_FORMAT_DEPTH16, color_width, color_height, stride_bytes, &pooled_transformed_depth_image ) );
+
+    // Create Point Cloud Image in Color Camera Geometry
+    stride_bytes = color_width * 3 * static_cast<int32_t>( sizeof( int16_t ) );
+    K4A_RESULT_CHECK( k4a_image_create( k4a_image_format_t::K4A_IMAGE_FORMAT_CUSTOM, color_width, color_height, stride_bytes, &pooled_xyz_image ) );
+}
+
 // Initialize Viewer
 inline void kinect::initialize_viewer()
 {
@@ -88,6 +110,10 @@ inline void kinect::initialize_viewer()
 // Finalize
 void kinect::finalize()
 {
+    // Release Pool of Transformed Images
+    k4a_image_release( pooled_transformed_depth_image );
+    k4a_image_release( pooled_xyz_image );
+
     // Destroy Transformation
     k4a_transformation_destroy( transformation );
 
@@ -201,10 +227,8 @@ inline void kinect::update_transformation()
     }
 
     // Transform Depth Image to Color Camera
-    const int32_t color_width  = k4a_image_get_width_pixels( color_image );
-    const int32_t color_height = k4a_image_get_height_pixels( color_image );
-    const int32_t stride_bytes = color_width * static_cast<int32_t>( sizeof( uint16_t ) );
-    K4A_RESULT_CHECK( k4a_image_create( k4a_image_format_t::K4A_IMAGE_FORMAT_DEPTH16, color_width, color_height, stride_bytes, &transformed_depth_image ) );
+    transformed_depth_image = pooled_transformed_depth_image;
+    k4a_image_reference( transformed_depth_image );
     K4A_RESULT_CHECK( k4a_transformation_depth_image_to_color_camera( transformation, depth_image, transformed_depth_image ) );
 }
 
@@ -216,10 +240,8 @@ inline void kinect::update_point_cloud()
     }
 
     // Transform Depth Image to Point Cloud
-    const int32_t transformed_depth_width  = k4a_image_get_width_pixels( transformed_depth_image );
-    const int32_t transformed_depth_height = k4a_image_get_height_pixels( transformed_depth_image );
-    const int32_t stride_bytes = transformed_depth_width * 3 * static_cast<int32_t>( sizeof(int16_t) );
-    K4A_RESULT_CHECK( k4a_image_create( k4a_image_format_t::K4A_IMAGE_FORMAT_CUSTOM, transformed_depth_width, transformed_depth_height, stride_bytes, &xyz_image ) );
+    xyz_image = pooled_xyz_image;
+    k4a_image_reference( xyz_image );
     K4A_RESULT_CHECK( k4a_transformation_depth_image_to_point_cloud( transformation, transformed_depth_image, k4a_calibration_type_t::K4A_CALIBRATION_TYPE_COLOR, xyz_image ) );
 }
 
@@ -246,8 +268,8 @@ inline void kinect::draw_color()
         return;
     }
 
-    // Get cv::Mat from k4a_image_t
-    color = k4a_get_mat( color_image );
+    // Get cv::Mat from k4a_image_t (Shared without Copy)
+    color = k4a_get_mat( color_image, false );
 
     // Release Color Image Handle
     k4a_image_release( color_image );
@@ -271,8 +293,8 @@ inline void kinect::draw_transformation()
         return;
     }
 
-    // Get cv::Mat from k4a_image_t
-    transformed_depth = k4a_get_mat( transformed_depth_image );
+    // Get cv::Mat from k4a_image_t (Shared without Copy)
+    transformed_depth = k4a_get_mat( transformed_depth_image, false );
 
     // Release Transformed Image Handle
     k4a_image_release( transformed_depth_image );
@@ -285,8 +307,8 @@ inline void kinect::draw_point_cloud()
         return;
     }
 
-    // Get cv::Mat from k4a_image_t
-    xyz = k4a_get_mat( xyz_image );
+    // Get cv::Mat from k4a_image_t (Invalid Points are NaN)
+    xyz = k4a_get_mat( xyz_image, false, true );
 
     // Release Point Cloud Image Handle
     k4a_image_release( xyz_image );
@@ -33,6 +33,10 @@ private:
     k4a_image_t xyz_image;
     cv::Mat xyz;
 
+    // Pool of Transformed Images
+    k4a_image_t pooled_transformed_depth_image;
+    k4a_image_t pooled_xyz_image;
+
     // Viewer
     #ifdef HAVE_OPENCV_VIZ
     cv::viz::Viz3d viewer;
@@ -64,6 +68,9 @@ private:
     // Initialize Sensor
     void initialize_sensor();
 
+    // Initialize Pool
+    void initialize_pool();
+
     // Initialize Viewer
     void initialize_viewer();
 
@@ -21,7 +21,9 @@ kinect::kinect( const uint32_t index )
       color_image( nullptr ),
       depth_image( nullptr ),
       transformed_color_image( nullptr ),
-      transformed_depth_image( nullptr )
+      transformed_depth_image( nullptr ),
+      pooled_transformed_color_image( nullptr ),
+      pooled_transformed_depth_image( nullptr )
 {
     // Initialize
     initialize();
@@ -38,6 +40,9 @@ void kinect::initialize()
 {
     // Initialize Sensor
     initialize_sensor();
+
+    // Initialize Pool
+    initialize_pool();
 }
 
 // Initialize Sensor
@@ -68,9 +73,32 @@ inline void kinect::initialize_sensor()
     transformation = k4a_transformation_create( &calibration );
 }
 
+// Initialize Pool
+inline void kinect::initialize_pool()
+{
+    // NOTE: Transformed images are allocated once, and reused in every frame.
+    int32_t stride_bytes;
+
+    // Create Color Image in Depth Camera Geometry
+    const int32_t depth_width  = calibration.depth_camera_calibration.resolution_width;
+    const int32_t depth_height = calibration.depth_camera_calibration.resolution_height;
+    stride_bytes = depth_width * 4 * static_cast<int32_t>( sizeof( uint8_t ) );
+    K4A_RESULT_CHECK( k4a_image_create( k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_BGRA32, depth_width, depth_height, stride_bytes, &pooled_transformed_color_image ) );
+
+    // Create Depth Image in Color Camera Geometry
+    const int32_t color_width  = calibration.color_camera_calibration.resolution_width;
+    const int32_t color_height = calibration.color_camera_calibration.resolution_height;
+    stride_bytes = color_width * static_cast<int32_t>( sizeof( uint16_t ) );
+    K4A_RESULT_CHECK( k4a_image_create( k4a_image_format_t::K4A_IMAGE_FORMAT_DEPTH16, color_width, color_height, stride_bytes, &pooled_transformed_depth_image ) );
+}
+
 // Finalize
 void kinect::finalize()
 {
+    // Release Pool of Transformed Images
+    k4a_image_release( pooled_transformed_color_image );
+    k4a_image_release( pooled_transformed_depth_image );
+
     // Destroy Transformation
     k4a_transformation_destroy( transformation );
 
@@ -169,20 +197,14 @@ inline void kinect::update_transformation()
         return;
     }
 
-    int32_t stride_bytes;
-
     // Transform Color Image to Depth Camera
-    const int32_t depth_width  = k4a_image_get_width_pixels( depth_image );
-    const int32_t depth_height = k4a_image_get_height_pixels( depth_image );
-    stride_bytes = depth_width * 4 * static_cast<int32_t>( sizeof( uint8_t ) );
-    K4A_RESULT_CHECK( k4a_image_create( k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_BGRA32, depth_width, depth_height, stride_bytes, &transformed_color_image ) );
+    transformed_color_image = pooled_transformed_color_image;
+    k4a_image_reference( transformed_color_image );
     K4A_RESULT_CHECK( k4a_transformation_color_image_to_depth_camera( transformation, depth_image, color_image, transformed_color_image ) );
 
     // Transform Depth Image to Color Camera
-    const int32_t color_width  = k4a_image_get_width_pixels( color_image );
-    const int32_t color_height = k4a_image_get_height_pixels( color_image );
-    stride_bytes = color_width * static_cast<int32_t>( sizeof( uint16_t ) );
-    K4A_RESULT_CHECK( k4a_image_create( k4a_image_format_t::K4A_IMAGE_FORMAT_DEPTH16, color_width, color_height, stride_bytes, &transformed_depth_image ) );
+    transformed_depth_image = pooled_transformed_depth_image;
+    k4a_image_reference( transformed_depth_image );
     K4A_RESULT_CHECK( k4a_transformation_depth_image_to_color_camera( transformation, depth_image, transformed_depth_image ) );
 }
 
@@ -206,8 +228,8 @@ inline void kinect::draw_color()
         return;
     }
 
-    // Get cv::Mat from k4a_image_t
-    color = k4a_get_mat( color_image );
+    // Get cv::Mat from k4a_image_t (Shared without Copy)
+    color = k4a_get_mat( color_image, false );
 
     // Release Color Image Handle
     k4a_image_release( color_image );
@@ -220,8 +242,8 @@ inline void kinect::draw_depth()
         return;
     }
 
-    // Get cv::Mat from k4a_image_t
-    depth = k4a_get_mat( depth_image );
+    // Get cv::Mat from k4a_image_t (Shared without Copy)
+    depth = k4a_get_mat( depth_image, false );
 
     // Release Depth Image Handle
     k4a_image_release( depth_image );
@@ -234,9 +256,9 @@ inline void kinect::draw_transformation()
         return;
     }
 
-    // Get cv::Mat from k4a_image_t
-    transformed_color = k4a_get_mat( transformed_color_image );
-    transformed_depth = k4a_get_mat( transformed_depth_image );
+    // Get cv::Mat from k4a_image_t (Shared without Copy)
+    transformed_color = k4a_get_mat( transformed_color_image, false );
+    transformed_depth = k4a_get_mat( transformed_depth_image, false );
 
     // Release Transformed Image Handle
     k4a_image_release( transformed_color_image );
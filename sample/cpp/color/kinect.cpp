@@ -27,33 +27,24 @@ void kinect::initialize()
 // Initialize Sensor
 inline void kinect::initialize_sensor()
 {
-    // Get Connected Devices
-    const int32_t device_count = k4a::device::get_installed_count();
-    if( device_count == 0 ){
-        throw k4a::error( "Failed to found device!" );
-    }
-
-    // Open Default Device
-    device = k4a::device::open( device_index );
-
-    // Start Cameras with Configuration
+    // Configuration
     device_configuration = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
     device_configuration.color_format             = k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_BGRA32;
     device_configuration.color_resolution         = k4a_color_resolution_t::K4A_COLOR_RESOLUTION_720P;
     device_configuration.depth_mode               = k4a_depth_mode_t::K4A_DEPTH_MODE_NFOV_UNBINNED;
     device_configuration.synchronized_images_only = true;
     device_configuration.wired_sync_mode          = k4a_wired_sync_mode_t::K4A_WIRED_SYNC_MODE_STANDALONE;
-    device.start_cameras( &device_configuration );
+
+    // Open Device and Start Cameras
+    // (Synthetic source is used instead of device if K4A_SOURCE=synthetic is set.)
+    source = k4a::open_source( device_index, device_configuration );
 }
 
 // Finalize
 void kinect::finalize()
 {
-    // Stop Cameras
-    device.stop_cameras();
-
-    // Close Device
-    device.close();
+    // Stop Cameras and Close Device
+    source->stop();
 
     // Close Window
     cv::destroyAllWindows();
@@ -100,7 +91,7 @@ inline void kinect::update_frame()
 {
     // Get Capture Frame
     constexpr std::chrono::milliseconds time_out( K4A_WAIT_INFINITE );
-    const bool result = device.get_capture( &capture, time_out );
+    const bool result = source->get_capture( &capture, time_out );
     if( !result ){
         this->~kinect();
     }
@@ -127,8 +118,8 @@ inline void kinect::draw_color()
         return;
     }
 
-    // Get cv::Mat from k4a::image
-    color = k4a::get_mat( color_image );
+    // Get cv::Mat from k4a::image (Shared without Copy)
+    color = k4a::get_mat( color_image, false );
 
     // Release Color Image Handle
     color_image.reset();
@@ -5,13 +5,15 @@
 #include <k4abt.hpp>
 #include <opencv2/opencv.hpp>
 
+#include "source.h"
+
 #include <vector>
 
 class kinect
 {
 private:
     // Kinect
-    k4a::device device;
+    std::unique_ptr<k4a::capture_source> source;
     k4a::capture capture;
     k4a::calibration calibration;
     k4a::transformation transformation;
@@ -4,11 +4,13 @@
 #include <k4a/k4a.hpp>
 #include <opencv2/opencv.hpp>
 
+#include "source.h"
+
 class kinect
 {
 private:
     // Kinect
-    k4a::device device;
+    std::unique_ptr<k4a::capture_source> source;
     k4a::capture capture;
     k4a_device_configuration_t device_configuration;
     uint32_t device_index;
@@ -0,0 +1,122 @@
+/*
+ This is utility to that provides cache of decoded color frames keyed by device timestamp of image.
+ Each color frame is decoded only once, and the decoded cv::Mat is shared by all stages that use it.
+
+ k4a::frame_cache cache( []( k4a::image& image ){ return k4a::get_mat( image ); } );
+ cv::Mat color = cache.get( color_image ); // decode
+ cv::Mat same  = cache.get( color_image ); // cached
+
+ Copyright (c) 2019 Tsukasa Sugiura <t.sugiura0204@gmail.com>
+ Licensed under the MIT license.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef __CACHE__
+#define __CACHE__
+
+#include <k4a/k4a.hpp>
+#include <opencv2/opencv.hpp>
+
+#include <deque>
+#include <algorithm>
+#include <utility>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+
+namespace k4a
+{
+    class frame_cache
+    {
+    public:
+        // Function to Decode Image (Called only at cache miss)
+        using decode_function = std::function<cv::Mat( k4a::image& )>;
+
+    private:
+        decode_function decode;
+        size_t capacity;
+        std::deque<std::pair<std::chrono::microseconds, cv::Mat>> frames;
+        uint64_t hits;
+        uint64_t misses;
+
+    public:
+        frame_cache( decode_function decode, const size_t capacity = 2 )
+            : decode( decode ),
+              capacity( std::max<size_t>( capacity, 1 ) ),
+              hits( 0 ),
+              misses( 0 )
+        {
+        }
+
+        // Get Decoded Frame of Image (Decode and store it if it is not cached)
+        cv::Mat get( k4a::image& image )
+        {
+            const std::chrono::microseconds timestamp = image.get_device_timestamp();
+            for( const std::pair<std::chrono::microseconds, cv::Mat>& frame : frames ){
+                if( frame.first == timestamp ){
+                    hits++;
+                    return frame.second;
+                }
+            }
+
+            misses++;
+            cv::Mat mat = decode( image );
+            put( timestamp, mat );
+            return mat;
+        }
+
+        // Put Frame that was Decoded Outside (e.g. k4a::decode_pool)
+        void put( const std::chrono::microseconds timestamp, const cv::Mat& mat )
+        {
+            for( std::pair<std::chrono::microseconds, cv::Mat>& frame : frames ){
+                if( frame.first == timestamp ){
+                    frame.second = mat;
+                    return;
+                }
+            }
+
+            // Evict the Oldest Frame
+            if( frames.size() >= capacity ){
+                frames.pop_front();
+            }
+            frames.emplace_back( timestamp, mat );
+        }
+
+        // Clear Cached Frames
+        void clear()
+        {
+            frames.clear();
+        }
+
+        // Get Number of Cache Hits
+        uint64_t get_hits() const
+        {
+            return hits;
+        }
+
+        // Get Number of Cache Misses (Number of Decoded Frames)
+        uint64_t get_misses() const
+        {
+            return misses;
+        }
+    };
+}
+
+#endif // __CACHE__
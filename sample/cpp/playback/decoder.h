@@ -0,0 +1,243 @@
+/*
+ This is utility to that provides pool of threads for decoding captures of playback in parallel.
+ The captures are read ahead from k4a::capture_source (e.g. k4a::playback_source), decoded on worker threads, and delivered in timestamp order.
+
+ k4a::decode_pool decoder( source, []( k4a::capture& capture ){ ... return color; }, 4, 8 );
+ k4a::capture capture;
+ cv::Mat color;
+ while( decoder.get_next( capture, color ) ){
+     ...
+ }
+
+ Copyright (c) 2019 Tsukasa Sugiura <t.sugiura0204@gmail.com>
+ Licensed under the MIT license.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef __DECODER__
+#define __DECODER__
+
+#include <k4a/k4a.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "pipeline.h"
+#include "source.h"
+
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <exception>
+#include <algorithm>
+#include <cstdint>
+
+namespace k4a
+{
+    class decode_pool
+    {
+    public:
+        // Function to Decode Capture (Called on worker threads)
+        using decode_function = std::function<cv::Mat( k4a::capture& )>;
+
+    private:
+        struct job
+        {
+            uint64_t sequence;
+            k4a::capture capture;
+        };
+
+        struct result
+        {
+            k4a::capture capture;
+            cv::Mat color;
+            std::exception_ptr error;
+        };
+
+        k4a::capture_source& source;
+        decode_function decode;
+        size_t read_ahead;
+
+        // Reader -> Workers
+        k4a::bounded_queue<job> jobs;
+
+        // Workers -> Consumer (Reordered by sequence)
+        std::map<uint64_t, result> results;
+        uint64_t read_count;
+        uint64_t next_sequence;
+        bool read_done;
+        bool stopping;
+        std::exception_ptr read_error;
+        std::mutex mutex;
+        std::condition_variable result_ready;
+        std::condition_variable slot_ready;
+
+        std::thread read_thread;
+        std::vector<std::thread> decode_threads;
+
+    public:
+        // NOTE: source must not be used by other threads until decode_pool is destroyed.
+        decode_pool( k4a::capture_source& source, decode_function decode, const size_t workers = std::max( 1u, std::thread::hardware_concurrency() ), const size_t read_ahead = 0 )
+            : source( source ),
+              decode( decode ),
+              read_ahead( ( read_ahead != 0 ) ? read_ahead : 2 * std::max<size_t>( workers, 1 ) ),
+              jobs( this->read_ahead, k4a::drop_policy::block ),
+              read_count( 0 ),
+              next_sequence( 0 ),
+              read_done( false ),
+              stopping( false )
+        {
+            read_thread = std::thread( &decode_pool::read_stage, this );
+            for( size_t i = 0; i < std::max<size_t>( workers, 1 ); i++ ){
+                decode_threads.emplace_back( &decode_pool::decode_stage, this );
+            }
+        }
+
+        decode_pool( const decode_pool& ) = delete;
+        decode_pool& operator=( const decode_pool& ) = delete;
+
+        ~decode_pool()
+        {
+            // Stop Reader and Workers (Queued captures are discarded without decoding, and only captures being decoded are finished)
+            {
+                std::lock_guard<std::mutex> lock( mutex );
+                stopping = true;
+            }
+            slot_ready.notify_all();
+            jobs.close();
+
+            if( read_thread.joinable() ){
+                read_thread.join();
+            }
+            for( std::thread& decode_thread : decode_threads ){
+                decode_thread.join();
+            }
+        }
+
+        // Get Next Capture and Decoded Color in Timestamp Order (Return false at EOF)
+        // (Exception thrown by reading or decoding is rethrown here.)
+        bool get_next( k4a::capture& capture, cv::Mat& color )
+        {
+            std::unique_lock<std::mutex> lock( mutex );
+            result_ready.wait( lock, [&]{ return results.count( next_sequence ) || ( read_done && next_sequence >= read_count ); } );
+
+            std::map<uint64_t, result>::iterator it = results.find( next_sequence );
+            if( it == results.end() ){
+                if( read_error ){
+                    std::rethrow_exception( read_error );
+                }
+                return false;
+            }
+
+            result value = std::move( it->second );
+            results.erase( it );
+            next_sequence++;
+            lock.unlock();
+            slot_ready.notify_one();
+
+            if( value.error ){
+                std::rethrow_exception( value.error );
+            }
+
+            capture = std::move( value.capture );
+            color = value.color;
+            return true;
+        }
+
+    private:
+        // Read Stage (Read ahead at most read_ahead captures from consumer)
+        void read_stage()
+        {
+            while( true ){
+                {
+                    std::unique_lock<std::mutex> lock( mutex );
+                    slot_ready.wait( lock, [&]{ return stopping || read_count - next_sequence < read_ahead; } );
+                    if( stopping ){
+                        break;
+                    }
+                }
+
+                job value;
+                try{
+                    if( !source.get_capture( &value.capture, std::chrono::milliseconds( K4A_WAIT_INFINITE ) ) ){
+                        break;
+                    }
+                }
+                catch( ... ){
+                    std::lock_guard<std::mutex> lock( mutex );
+                    read_error = std::current_exception();
+                    break;
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock( mutex );
+                    value.sequence = read_count++;
+                }
+
+                if( !jobs.push( std::move( value ) ) ){
+                    break;
+                }
+            }
+
+            // Notify EOF after workers finished remaining jobs
+            jobs.close();
+            {
+                std::lock_guard<std::mutex> lock( mutex );
+                read_done = true;
+            }
+            result_ready.notify_all();
+        }
+
+        // Decode Stage
+        void decode_stage()
+        {
+            job value;
+            while( jobs.pop( value ) ){
+                // Discard Queued Jobs without Decoding after Stopping
+                {
+                    std::lock_guard<std::mutex> lock( mutex );
+                    if( stopping ){
+                        value.capture.reset();
+                        continue;
+                    }
+                }
+
+                result decoded;
+                try{
+                    decoded.color = decode( value.capture );
+                }
+                catch( ... ){
+                    decoded.error = std::current_exception();
+                }
+                decoded.capture = std::move( value.capture );
+
+                {
+                    std::lock_guard<std::mutex> lock( mutex );
+                    results.emplace( value.sequence, std::move( decoded ) );
+                }
+                result_ready.notify_all();
+            }
+        }
+    };
+}
+
+#endif // __DECODER__
@@ -0,0 +1,451 @@
+/*
+ This is utility to that provides raw frame dump format for fast repeated playback.
+ Decoded color (BGRA), depth and infrared images are stored at fixed stride and page aligned offsets,
+ so that the file can be memory mapped and its images can be used without decode and copy.
+
+ // Write
+ k4a::frame_dump_writer writer( "file.dump", playback.get_raw_calibration(), playback.get_record_configuration(), playback.get_calibration() );
+ writer.write( color, color_timestamp, depth_image, ir_image );
+ writer.close();
+
+ // Read
+ k4a::frame_dump dump( "file.dump" );
+ k4a::capture capture = dump.get_capture( 0 );
+
+ Copyright (c) 2019 Tsukasa Sugiura <t.sugiura0204@gmail.com>
+ Licensed under the MIT license.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef __DUMP__
+#define __DUMP__
+
+#include <k4a/k4a.hpp>
+#include <k4arecord/playback.hpp>
+#include <opencv2/opencv.hpp>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace k4a
+{
+    // Layout of Raw Frame Dump
+    //
+    // [header][raw calibration] (padded to page)
+    // [frame 0] [frame 1] ... [frame N-1] (each frame is frame_stride bytes)
+    //
+    // [frame] = [frame_header] (padded to page) [color (BGRA)] (padded to page) [depth] (padded to page) [infrared] (padded to page)
+    namespace dump
+    {
+        constexpr char magic[8] = { 'K', '4', 'A', 'D', 'U', 'M', 'P', '1' };
+        constexpr uint64_t page_size = 4096;
+
+        struct header
+        {
+            char magic[8];
+            uint64_t page_size;
+            int32_t depth_mode;
+            int32_t color_resolution;
+            int32_t color_width;
+            int32_t color_height;
+            int32_t depth_width;
+            int32_t depth_height;
+            uint64_t calibration_offset;
+            uint64_t calibration_size;
+            uint64_t frame_offset;
+            uint64_t frame_stride;
+            uint64_t frame_count;
+            uint64_t color_offset; // Offset from beginning of frame
+            uint64_t depth_offset;
+            uint64_t ir_offset;
+        };
+
+        struct frame_header
+        {
+            int64_t color_timestamp; // Device timestamp (usec), -1 if image doesn't exist
+            int64_t depth_timestamp;
+            int64_t ir_timestamp;
+        };
+
+        inline uint64_t align( const uint64_t size )
+        {
+            return ( size + page_size - 1 ) / page_size * page_size;
+        }
+    }
+
+    class frame_dump_writer
+    {
+    private:
+        std::ofstream stream;
+        dump::header header;
+        std::vector<char> frame;
+
+    public:
+        frame_dump_writer( const std::string& path, const std::vector<uint8_t>& raw_calibration, const k4a_record_configuration_t& record_configuration, const k4a::calibration& calibration )
+        {
+            stream.open( path, std::ios::binary | std::ios::trunc );
+            if( !stream.is_open() ){
+                throw k4a::error( "Failed to open dump file!" );
+            }
+
+            // Layout of Frame
+            const k4a_calibration_camera_t& color_camera = calibration.color_camera_calibration;
+            const k4a_calibration_camera_t& depth_camera = calibration.depth_camera_calibration;
+
+            std::memset( &header, 0, sizeof( dump::header ) );
+            std::memcpy( header.magic, dump::magic, sizeof( dump::magic ) );
+            header.page_size          = dump::page_size;
+            header.depth_mode         = static_cast<int32_t>( record_configuration.depth_mode );
+            header.color_resolution   = static_cast<int32_t>( record_configuration.color_resolution );
+            header.color_width        = color_camera.resolution_width;
+            header.color_height       = color_camera.resolution_height;
+            header.depth_width        = depth_camera.resolution_width;
+            header.depth_height       = depth_camera.resolution_height;
+            header.calibration_offset = sizeof( dump::header );
+            header.calibration_size   = raw_calibration.size();
+            header.frame_offset       = dump::align( header.calibration_offset + header.calibration_size );
+            header.color_offset       = dump::align( sizeof( dump::frame_header ) );
+            header.depth_offset       = header.color_offset + dump::align( get_color_size() );
+            header.ir_offset          = header.depth_offset + dump::align( get_depth_size() );
+            header.frame_stride       = header.ir_offset + dump::align( get_depth_size() );
+            header.frame_count        = 0;
+
+            // Write Header and Calibration
+            stream.write( reinterpret_cast<const char*>( &header ), sizeof( dump::header ) );
+            stream.write( reinterpret_cast<const char*>( raw_calibration.data() ), static_cast<std::streamsize>( raw_calibration.size() ) );
+            const std::vector<char> padding( static_cast<size_t>( header.frame_offset - header.calibration_offset - header.calibration_size ), 0 );
+            stream.write( padding.data(), static_cast<std::streamsize>( padding.size() ) );
+            if( !stream ){
+                throw k4a::error( "Failed to write dump! (header could not be written)" );
+            }
+
+            frame.resize( static_cast<size_t>( header.frame_stride ) );
+        }
+
+        ~frame_dump_writer()
+        {
+            // NOTE: Destructor must not throw, call close() explicitly to detect failure.
+            try{
+                close();
+            }
+            catch( const k4a::error& ){
+            }
+        }
+
+        // Write Frame
+        // (color is decoded BGRA image, depth_image and ir_image are DEPTH16 and IR16. Empty image is allowed.)
+        void write( const cv::Mat& color, const std::chrono::microseconds color_timestamp, const k4a::image& depth_image, const k4a::image& ir_image )
+        {
+            std::fill( frame.begin(), frame.end(), 0 );
+
+            dump::frame_header frame_header;
+            frame_header.color_timestamp = -1;
+            frame_header.depth_timestamp = -1;
+            frame_header.ir_timestamp    = -1;
+
+            if( !color.empty() ){
+                if( color.type() != CV_8UC4 || color.cols != header.color_width || color.rows != header.color_height ){
+                    throw k4a::error( "Failed to write dump! (color must be BGRA image of color camera resolution)" );
+                }
+
+                const size_t row_bytes = static_cast<size_t>( color.cols ) * color.elemSize();
+                for( int32_t y = 0; y < color.rows; y++ ){
+                    std::memcpy( &frame[static_cast<size_t>( header.color_offset ) + y * row_bytes], color.ptr( y ), row_bytes );
+                }
+                frame_header.color_timestamp = static_cast<int64_t>( color_timestamp.count() );
+            }
+
+            if( depth_image.handle() ){
+                copy( depth_image, header.depth_offset );
+                frame_header.depth_timestamp = static_cast<int64_t>( depth_image.get_device_timestamp().count() );
+            }
+
+            if( ir_image.handle() ){
+                copy( ir_image, header.ir_offset );
+                frame_header.ir_timestamp = static_cast<int64_t>( ir_image.get_device_timestamp().count() );
+            }
+
+            std::memcpy( &frame[0], &frame_header, sizeof( dump::frame_header ) );
+            stream.write( frame.data(), static_cast<std::streamsize>( frame.size() ) );
+            if( !stream ){
+                throw k4a::error( "Failed to write dump! (frame could not be written)" );
+            }
+            header.frame_count++;
+        }
+
+        // Close File (Number of frames is written to header)
+        void close()
+        {
+            if( !stream.is_open() ){
+                return;
+            }
+
+            stream.seekp( 0 );
+            stream.write( reinterpret_cast<const char*>( &header ), sizeof( dump::header ) );
+            stream.close();
+            if( !stream ){
+                throw k4a::error( "Failed to write dump! (number of frames could not be written to header)" );
+            }
+        }
+
+    private:
+        uint64_t get_color_size() const
+        {
+            return static_cast<uint64_t>( header.color_width ) * header.color_height * 4;
+        }
+
+        uint64_t get_depth_size() const
+        {
+            return static_cast<uint64_t>( header.depth_width ) * header.depth_height * sizeof( uint16_t );
+        }
+
+        void copy( const k4a::image& image, const uint64_t offset )
+        {
+            if( image.get_width_pixels() != header.depth_width || image.get_height_pixels() != header.depth_height ){
+                throw k4a::error( "Failed to write dump! (image must be depth camera resolution)" );
+            }
+
+            const size_t row_bytes = static_cast<size_t>( header.depth_width ) * sizeof( uint16_t );
+            const uint8_t* buffer = image.get_buffer();
+            for( int32_t y = 0; y < header.depth_height; y++ ){
+                std::memcpy( &frame[static_cast<size_t>( offset ) + y * row_bytes], buffer + y * image.get_stride_bytes(), row_bytes );
+            }
+        }
+    };
+
+    class frame_dump
+    {
+    private:
+        uint8_t* data;
+        uint64_t data_size;
+        dump::header header;
+        #ifdef _WIN32
+        HANDLE file;
+        HANDLE mapping;
+        #endif
+
+    public:
+        frame_dump()
+            : data( nullptr ),
+              data_size( 0 )
+        {
+            std::memset( &header, 0, sizeof( dump::header ) );
+            #ifdef _WIN32
+            file = INVALID_HANDLE_VALUE;
+            mapping = nullptr;
+            #endif
+        }
+
+        frame_dump( const std::string& path )
+            : frame_dump()
+        {
+            open( path );
+        }
+
+        frame_dump( const frame_dump& ) = delete;
+        frame_dump& operator=( const frame_dump& ) = delete;
+
+        ~frame_dump()
+        {
+            close();
+        }
+
+        // Open File with Memory Mapping
+        // NOTE: File is mapped as copy-on-write, so that images can be passed to k4a APIs without copy.
+        void open( const std::string& path )
+        {
+            close();
+
+            #ifdef _WIN32
+            file = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+            if( file == INVALID_HANDLE_VALUE ){
+                throw k4a::error( "Failed to open dump file!" );
+            }
+
+            LARGE_INTEGER size;
+            if( !GetFileSizeEx( file, &size ) ){
+                close();
+                throw k4a::error( "Failed to open dump file!" );
+            }
+            data_size = static_cast<uint64_t>( size.QuadPart );
+
+            mapping = CreateFileMappingA( file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr );
+            if( mapping == nullptr ){
+                close();
+                throw k4a::error( "Failed to map dump file!" );
+            }
+
+            data = static_cast<uint8_t*>( MapViewOfFile( mapping, FILE_MAP_COPY, 0, 0, 0 ) );
+            if( data == nullptr ){
+                close();
+                throw k4a::error( "Failed to map dump file!" );
+            }
+            #else
+            const int32_t descriptor = ::open( path.c_str(), O_RDONLY );
+            if( descriptor < 0 ){
+                throw k4a::error( "Failed to open dump file!" );
+            }
+
+            struct stat status;
+            if( fstat( descriptor, &status ) < 0 ){
+                ::close( descriptor );
+                throw k4a::error( "Failed to open dump file!" );
+            }
+            data_size = static_cast<uint64_t>( status.st_size );
+
+            void* address = mmap( nullptr, static_cast<size_t>( data_size ), PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0 );
+            ::close( descriptor );
+            if( address == MAP_FAILED ){
+                data = nullptr;
+                throw k4a::error( "Failed to map dump file!" );
+            }
+            data = static_cast<uint8_t*>( address );
+            #endif
+
+            // Check Header
+            if( data_size < sizeof( dump::header ) ){
+                close();
+                throw k4a::error( "Failed to open dump file! (file is broken)" );
+            }
+
+            std::memcpy( &header, data, sizeof( dump::header ) );
+            if( std::memcmp( header.magic, dump::magic, sizeof( dump::magic ) ) != 0 || header.frame_offset + header.frame_stride * header.frame_count > data_size ){
+                close();
+                throw k4a::error( "Failed to open dump file! (file is broken)" );
+            }
+        }
+
+        // Close File
+        void close()
+        {
+            #ifdef _WIN32
+            if( data != nullptr ){
+                UnmapViewOfFile( data );
+            }
+            if( mapping != nullptr ){
+                CloseHandle( mapping );
+                mapping = nullptr;
+            }
+            if( file != INVALID_HANDLE_VALUE ){
+                CloseHandle( file );
+                file = INVALID_HANDLE_VALUE;
+            }
+            #else
+            if( data != nullptr ){
+                munmap( data, static_cast<size_t>( data_size ) );
+            }
+            #endif
+            data = nullptr;
+            data_size = 0;
+        }
+
+        // Get Number of Frames
+        size_t size() const
+        {
+            return static_cast<size_t>( header.frame_count );
+        }
+
+        // Get Calibration
+        k4a::calibration get_calibration() const
+        {
+            return k4a::calibration::get_from_raw( data + header.calibration_offset, static_cast<size_t>( header.calibration_size ), static_cast<k4a_depth_mode_t>( header.depth_mode ), static_cast<k4a_color_resolution_t>( header.color_resolution ) );
+        }
+
+        // Get Capture of Frame
+        // (Images refer to mapped memory without copy. They must be released before frame_dump is closed.)
+        k4a::capture get_capture( const size_t frame_number ) const
+        {
+            if( frame_number >= size() ){
+                throw k4a::error( "Failed to get capture! (frame number is out of range)" );
+            }
+
+            uint8_t* frame = data + header.frame_offset + header.frame_stride * frame_number;
+            dump::frame_header frame_header;
+            std::memcpy( &frame_header, frame, sizeof( dump::frame_header ) );
+
+            k4a::capture capture = k4a::capture::create();
+            if( frame_header.color_timestamp >= 0 ){
+                capture.set_color_image( wrap( k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_BGRA32, header.color_width, header.color_height, 4, frame + header.color_offset, frame_header.color_timestamp ) );
+            }
+            if( frame_header.depth_timestamp >= 0 ){
+                capture.set_depth_image( wrap( k4a_image_format_t::K4A_IMAGE_FORMAT_DEPTH16, header.depth_width, header.depth_height, sizeof( uint16_t ), frame + header.depth_offset, frame_header.depth_timestamp ) );
+            }
+            if( frame_header.ir_timestamp >= 0 ){
+                capture.set_ir_image( wrap( k4a_image_format_t::K4A_IMAGE_FORMAT_IR16, header.depth_width, header.depth_height, sizeof( uint16_t ), frame + header.ir_offset, frame_header.ir_timestamp ) );
+            }
+            return capture;
+        }
+
+        // Find Frame Number of the First Frame at or after Device Timestamp (Return size() if not found)
+        // (Earliest timestamp of images in frame is used as same as k4a::frame_index.)
+        size_t find( const std::chrono::microseconds timestamp ) const
+        {
+            size_t begin = 0;
+            size_t end = size();
+            while( begin < end ){
+                const size_t middle = begin + ( end - begin ) / 2;
+                dump::frame_header frame_header;
+                std::memcpy( &frame_header, data + header.frame_offset + header.frame_stride * middle, sizeof( dump::frame_header ) );
+                int64_t frame_timestamp = std::numeric_limits<int64_t>::max();
+                for( const int64_t image_timestamp : { frame_header.color_timestamp, frame_header.depth_timestamp, frame_header.ir_timestamp } ){
+                    if( image_timestamp >= 0 ){
+                        frame_timestamp = std::min( frame_timestamp, image_timestamp );
+                    }
+                }
+                if( frame_timestamp < timestamp.count() ){
+                    begin = middle + 1;
+                }
+                else{
+                    end = middle;
+                }
+            }
+            return begin;
+        }
+
+    private:
+        static k4a::image wrap( const k4a_image_format_t format, const int32_t width, const int32_t height, const int32_t pixel_bytes, uint8_t* buffer, const int64_t timestamp )
+        {
+            const int32_t stride_bytes = width * pixel_bytes;
+            k4a::image image = k4a::image::create_from_buffer( format, width, height, stride_bytes, buffer, static_cast<size_t>( stride_bytes ) * height, nullptr, nullptr );
+            image.set_timestamp( std::chrono::microseconds( timestamp ) );
+            return image;
+        }
+    };
+}
+
+#endif // __DUMP__
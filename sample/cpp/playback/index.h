@@ -0,0 +1,210 @@
+/*
+ This is utility to that provides index of frames for random access to playback file.
+ The index (device timestamp of each capture) is built once, and cached next to the playback file (e.g. file.mkv.index).
+
+ k4a::frame_index index = k4a::frame_index::load( "file.mkv" );
+ std::chrono::microseconds timestamp = index.get_timestamp( 100 ); // timestamp of 100th capture
+ size_t frame_number = index.find( timestamp );                     // frame number of timestamp
+
+ Copyright (c) 2019 Tsukasa Sugiura <t.sugiura0204@gmail.com>
+ Licensed under the MIT license.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef __INDEX__
+#define __INDEX__
+
+#include <k4a/k4a.hpp>
+#include <k4arecord/playback.hpp>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if __has_include(<filesystem>)
+#include <filesystem>
+namespace filesystem = std::filesystem;
+#else
+#include <experimental/filesystem>
+#if _WIN32
+namespace filesystem = std::experimental::filesystem::v1;
+#else
+namespace filesystem = std::experimental::filesystem;
+#endif
+#endif
+
+namespace k4a
+{
+    class frame_index
+    {
+    private:
+        // Header of Index File
+        struct header
+        {
+            char magic[8];
+            uint64_t file_size;
+            int64_t file_time;
+            uint64_t count;
+        };
+
+        static constexpr char magic[8] = { 'K', '4', 'A', 'I', 'N', 'D', 'X', '1' };
+
+        std::vector<std::chrono::microseconds> timestamps;
+
+    public:
+        frame_index() = default;
+
+        // Load Index of Playback File (Build and cache it if index file doesn't exist or is outdated)
+        static frame_index load( const filesystem::path& file )
+        {
+            frame_index index;
+            const filesystem::path index_file = get_index_file( file );
+            if( index.read( file, index_file ) ){
+                return index;
+            }
+
+            index.build( file );
+            index.write( file, index_file );
+            return index;
+        }
+
+        // Get Path of Index File
+        static filesystem::path get_index_file( const filesystem::path& file )
+        {
+            filesystem::path index_file = file;
+            index_file += ".index";
+            return index_file;
+        }
+
+        // Get Number of Captures
+        size_t size() const
+        {
+            return timestamps.size();
+        }
+
+        // Get Device Timestamp of Capture (O(1))
+        std::chrono::microseconds get_timestamp( const size_t frame_number ) const
+        {
+            if( frame_number >= timestamps.size() ){
+                throw k4a::error( "Failed to get timestamp! (frame number is out of range)" );
+            }
+            return timestamps[frame_number];
+        }
+
+        // Find Frame Number of the First Capture at or after Device Timestamp (O(log N))
+        // (Return size() if timestamp is after the last capture.)
+        size_t find( const std::chrono::microseconds timestamp ) const
+        {
+            return static_cast<size_t>( std::lower_bound( timestamps.begin(), timestamps.end(), timestamp ) - timestamps.begin() );
+        }
+
+    private:
+        // Build Index by Reading All Captures
+        void build( const filesystem::path& file )
+        {
+            k4a::playback playback = k4a::playback::open( file.generic_string().c_str() );
+
+            timestamps.clear();
+            k4a::capture capture;
+            while( playback.get_next_capture( &capture ) ){
+                // NOTE: k4a::playback::seek_timestamp() seeks to the first capture that contains image at or after timestamp,
+                //       so the earliest timestamp of images in capture is used as timestamp of capture.
+                timestamps.push_back( get_timestamp( capture ) );
+                capture.reset();
+            }
+
+            playback.close();
+        }
+
+        // Read Index File
+        bool read( const filesystem::path& file, const filesystem::path& index_file )
+        {
+            std::ifstream stream( index_file.generic_string(), std::ios::binary );
+            if( !stream.is_open() ){
+                return false;
+            }
+
+            header value;
+            if( !stream.read( reinterpret_cast<char*>( &value ), sizeof( header ) ) ){
+                return false;
+            }
+
+            // Check Index File is Built from Same Playback File
+            if( std::memcmp( value.magic, magic, sizeof( magic ) ) != 0 || value.file_size != filesystem::file_size( file ) || value.file_time != get_file_time( file ) ){
+                return false;
+            }
+
+            std::vector<int64_t> values( static_cast<size_t>( value.count ) );
+            if( !stream.read( reinterpret_cast<char*>( values.data() ), static_cast<std::streamsize>( values.size() * sizeof( int64_t ) ) ) ){
+                return false;
+            }
+
+            timestamps.resize( values.size() );
+            std::transform( values.begin(), values.end(), timestamps.begin(), []( const int64_t value ){ return std::chrono::microseconds( value ); } );
+            return true;
+        }
+
+        // Write Index File
+        // (If index file can't be written (e.g. read only directory), index is used without cache.)
+        void write( const filesystem::path& file, const filesystem::path& index_file ) const
+        {
+            std::ofstream stream( index_file.generic_string(), std::ios::binary | std::ios::trunc );
+            if( !stream.is_open() ){
+                return;
+            }
+
+            header value;
+            std::memcpy( value.magic, magic, sizeof( magic ) );
+            value.file_size = filesystem::file_size( file );
+            value.file_time = get_file_time( file );
+            value.count = timestamps.size();
+            stream.write( reinterpret_cast<const char*>( &value ), sizeof( header ) );
+
+            std::vector<int64_t> values( timestamps.size() );
+            std::transform( timestamps.begin(), timestamps.end(), values.begin(), []( const std::chrono::microseconds timestamp ){ return static_cast<int64_t>( timestamp.count() ); } );
+            stream.write( reinterpret_cast<const char*>( values.data() ), static_cast<std::streamsize>( values.size() * sizeof( int64_t ) ) );
+        }
+
+        // Get Earliest Device Timestamp of Images in Capture
+        static std::chrono::microseconds get_timestamp( k4a::capture& capture )
+        {
+            std::chrono::microseconds timestamp = std::chrono::microseconds::max();
+            const k4a::image images[] = { capture.get_color_image(), capture.get_depth_image(), capture.get_ir_image() };
+            for( const k4a::image& image : images ){
+                if( image.handle() ){
+                    timestamp = std::min( timestamp, image.get_device_timestamp() );
+                }
+            }
+            return timestamp;
+        }
+
+        // Get Last Write Time of File
+        static int64_t get_file_time( const filesystem::path& file )
+        {
+            return static_cast<int64_t>( filesystem::last_write_time( file ).time_since_epoch().count() );
+        }
+    };
+}
+
+#endif // __INDEX__
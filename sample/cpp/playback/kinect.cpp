@@ -2,10 +2,35 @@
 #include "util.h"
 
 #include <chrono>
+#include <iostream>
+#include <thread>
+#include <algorithm>
+#include <limits>
+
+// Decode Color Image to cv::Mat (Return empty cv::Mat if color image failed to decode)
+static cv::Mat decode_color( k4a::image& color_image )
+{
+    // NOTE: BGRA image (e.g. from dump file) is shared without copy.
+    try{
+        return k4a::get_mat( color_image, false );
+    }
+    catch( const k4a::error& error ){
+        std::cerr << "warning: " << error.what() << std::endl;
+        return cv::Mat();
+    }
+}
 
 // Constructor
 kinect::kinect( const uint32_t index )
-    : device_index( index )
+    : playback( nullptr ),
+      device_index( index ),
+      dump_frame( 0 ),
+      decode_workers( 0 ),
+      read_ahead( 0 ),
+      color_cache( decode_color ),
+      windowed( false ),
+      frame_timestamp( 0 ),
+      frame_system_timestamp( 0 )
 {
     // Initialize
     initialize();
@@ -13,7 +38,15 @@ kinect::kinect( const uint32_t index )
 
 // Constructor
 kinect::kinect( const filesystem::path path )
-    : playback_file( path )
+    : playback( nullptr ),
+      playback_file( path ),
+      dump_frame( 0 ),
+      decode_workers( std::max( 1u, std::thread::hardware_concurrency() ) ),
+      read_ahead( 0 ),
+      color_cache( decode_color ),
+      windowed( false ),
+      frame_timestamp( 0 ),
+      frame_system_timestamp( 0 )
 {
     // Initialize
     initialize();
@@ -32,6 +65,10 @@ void kinect::initialize()
         // Initialize Sensor
         initialize_sensor();
     }
+    else if( is_dump() ){
+        // Initialize Dump
+        initialize_dump();
+    }
     else{
         // Initialize Playback
         initialize_playback();
@@ -41,29 +78,26 @@ void kinect::initialize()
 // Initialize Sensor
 inline void kinect::initialize_sensor()
 {
-    // Get Connected Devices
-    const int32_t device_count = k4a::device::get_installed_count();
-    if( device_count == 0 ){
-        throw k4a::error( "Failed to found device!" );
-    }
-
-    // Open Device
-    device = k4a::device::open( device_index );
-
-    // Start Cameras with Configuration
+    // Configuration
     device_configuration = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
     device_configuration.color_format             = k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_BGRA32;
     device_configuration.color_resolution         = k4a_color_resolution_t::K4A_COLOR_RESOLUTION_720P;
     device_configuration.depth_mode               = k4a_depth_mode_t::K4A_DEPTH_MODE_NFOV_UNBINNED;
     device_configuration.synchronized_images_only = true;
     device_configuration.wired_sync_mode          = k4a_wired_sync_mode_t::K4A_WIRED_SYNC_MODE_STANDALONE;
-    device.start_cameras( &device_configuration );
+
+    // Open Device and Start Cameras
+    // (Synthetic source is used instead of device if K4A_SOURCE=synthetic is set.)
+    source = k4a::open_source( device_index, device_configuration );
 
     // Get Calibration
-    calibration = device.get_calibration( device_configuration.depth_mode, device_configuration.color_resolution );
+    calibration = source->get_calibration();
 
     // Create Transformation
     transformation = k4a::transformation( calibration );
+
+    // Create Pool of Transformed Images
+    pool.reset( calibration );
 }
 
 // Initialize Playback
@@ -74,35 +108,206 @@ inline void kinect::initialize_playback()
     }
 
     // Open Playback
-    playback = k4a::playback::open( playback_file.generic_string().c_str() );
+    // (Captures are read through k4a::capture_source as same as sensor.)
+    std::unique_ptr<k4a::playback_source> playback_source( new k4a::playback_source( playback_file.generic_string() ) );
+    playback = playback_source.get();
+    source = std::move( playback_source );
 
     // Get Calibration
-    calibration = playback.get_calibration();
+    calibration = source->get_calibration();
 
     // Create Transformation
     transformation = k4a::transformation( calibration );
+
+    // Create Pool of Transformed Images
+    pool.reset( calibration );
+}
+
+// Initialize Dump
+inline void kinect::initialize_dump()
+{
+    if( !filesystem::is_regular_file( playback_file ) || !filesystem::exists( playback_file ) ){
+        throw k4a::error( "Failed to found file path!" );
+    }
+
+    // Open Dump with Memory Mapping
+    dump.open( playback_file.generic_string() );
+
+    // Get Calibration
+    calibration = dump.get_calibration();
+
+    // Create Transformation
+    transformation = k4a::transformation( calibration );
+
+    // Create Pool of Transformed Images
+    pool.reset( calibration );
+}
+
+// Check Playback File is Raw Frame Dump
+inline bool kinect::is_dump() const
+{
+    return playback_file.extension() == ".dump";
 }
 
 // Finalize
 void kinect::finalize()
 {
+    // Stop Decoder before Closing Playback
+    decoder.reset();
+
     // Destroy Transformation
     transformation.destroy();
 
     if( playback_file.empty() ){
-        // Stop Cameras
-        device.stop_cameras();
-
-        // Close Device
-        device.close();
+        // Stop Cameras and Close Device
+        source->stop();
+    }
+    else if( is_dump() ){
+        // Release Images that Refer to Memory Mapped File, and Close Dump
+        capture.reset();
+        color_image.reset();
+        depth_image.reset();
+        color_cache.clear();
+        color.release();
+        depth.release();
+        dump.close();
     }
     else{
         // Close Playback
-        playback.close();
+        source->stop();
+    }
+
+    // Close Window (Batch mode doesn't open any windows)
+    if( windowed ){
+        cv::destroyAllWindows();
+    }
+}
+
+// Configure Decoder
+void kinect::configure_decoder( const size_t workers, const size_t read_ahead )
+{
+    if( decoder ){
+        throw k4a::error( "Failed to configure decoder! (decoder is already running)" );
     }
 
-    // Close Window
-    cv::destroyAllWindows();
+    decode_workers = workers;
+    this->read_ahead = read_ahead;
+}
+
+// Load Index
+inline void kinect::load_index()
+{
+    if( playback_file.empty() ){
+        throw k4a::error( "Failed to load index! (sensor doesn't have index)" );
+    }
+
+    // Load Index from Index File, or Build Index at First Time
+    if( index.size() == 0 ){
+        index = k4a::frame_index::load( playback_file );
+    }
+}
+
+// Seek
+void kinect::seek( const std::chrono::microseconds timestamp )
+{
+    if( playback_file.empty() ){
+        throw k4a::error( "Failed to seek! (sensor can't seek)" );
+    }
+
+    if( is_dump() ){
+        dump_frame = dump.find( timestamp );
+        return;
+    }
+
+    // Stop Decoder and Discard Frames Read Ahead (Decoder is restarted at next frame)
+    decoder.reset();
+    color_cache.clear();
+
+    // Seek Playback
+    playback->seek( timestamp );
+}
+
+// Get Capture at Frame Number
+k4a::capture kinect::get_capture_at( const size_t frame_number )
+{
+    // Seek to Frame Number, and Get Capture
+    seek_frame( frame_number );
+    if( !update_frame() ){
+        throw k4a::error( "Failed to get capture!" );
+    }
+
+    return capture;
+}
+
+// Get Number of Frames
+size_t kinect::get_frame_count()
+{
+    if( is_dump() ){
+        return dump.size();
+    }
+
+    load_index();
+    return index.size();
+}
+
+// Seek to Frame Number
+inline void kinect::seek_frame( const size_t frame_number )
+{
+    if( frame_number >= get_frame_count() ){
+        throw k4a::error( "Failed to seek! (frame number is out of range)" );
+    }
+
+    if( is_dump() ){
+        // Dump can be accessed at any frame directly
+        dump_frame = frame_number;
+        return;
+    }
+
+    // Seek to Timestamp of Frame Number
+    seek( index.get_timestamp( frame_number ) );
+}
+
+// Convert
+void kinect::convert( const filesystem::path& dump_file )
+{
+    if( playback_file.empty() || is_dump() ){
+        throw k4a::error( "Failed to convert! (only playback file can be converted)" );
+    }
+
+    // Create Writer with Calibration of Playback
+    k4a::frame_dump_writer writer( dump_file.generic_string(), playback->get_raw_calibration(), playback->get_record_configuration(), calibration );
+
+    // Write All Frames (Color is decoded by decoder)
+    while( update_frame() ){
+        color_image = capture.get_color_image();
+        depth_image = capture.get_depth_image();
+        const k4a::image ir_image = capture.get_ir_image();
+
+        if( color_image.handle() ){
+            writer.write( color_cache.get( color_image ), color_image.get_device_timestamp(), depth_image, ir_image );
+        }
+        else{
+            writer.write( cv::Mat(), std::chrono::microseconds( 0 ), depth_image, ir_image );
+        }
+
+        capture.reset();
+        color_image.reset();
+        depth_image.reset();
+    }
+
+    writer.close();
+}
+
+// Configure Profiler
+void kinect::configure_profiler( const std::string& file )
+{
+    profile_file = file;
+
+    // Keep Events for Trace
+    if( filesystem::path( file ).extension() == ".json" ){
+        constexpr size_t trace_capacity = 1 << 18;
+        profiler.enable_trace( trace_capacity );
+    }
 }
 
 // Run
@@ -110,8 +315,10 @@ void kinect::run()
 {
     // Main Loop
     while( true ){
-        // Update
-        update();
+        // Update (Break at EOF)
+        if( !update() ){
+            break;
+        }
 
         // Draw
         draw();
@@ -125,14 +332,90 @@ void kinect::run()
         if( key == 'q' ){
             break;
         }
+
+        // Record Latency from Sensor to Display (Window is updated in cv::waitKey())
+        profiler.record_latency( frame_timestamp, frame_system_timestamp, k4a::profiler::clock::now() );
     }
+
+    // Show Profile, and Write to File
+    profiler.print( std::cout );
+    if( !profile_file.empty() ){
+        profiler.write( profile_file );
+    }
+}
+
+// Run Batch
+kinect::statistics kinect::run_batch()
+{
+    return run_batch( 0, std::numeric_limits<size_t>::max(), nullptr );
+}
+
+// Run Batch on Range of Frames
+kinect::statistics kinect::run_batch( const size_t begin_frame, const size_t end_frame, const output_function& output )
+{
+    using clock = std::chrono::steady_clock;
+
+    statistics result = {};
+    const clock::time_point start = clock::now();
+
+    // Seek to Begin Frame
+    if( begin_frame > 0 ){
+        if( begin_frame >= get_frame_count() ){
+            return result;
+        }
+        seek_frame( begin_frame );
+    }
+
+    // Process All Frames as Fast as Possible without Draw and Show
+    for( size_t frame_number = begin_frame; frame_number < end_frame; frame_number++ ){
+        // Update Frame (Break at EOF)
+        const clock::time_point read_start = clock::now();
+        if( !update_frame() ){
+            break;
+        }
+
+        // Update Color and Depth
+        update_color();
+        update_depth();
+        const clock::time_point transformation_start = clock::now();
+
+        // Update Transformation
+        update_transformation();
+        const clock::time_point transformation_end = clock::now();
+
+        // Output Frame
+        if( output && transformed_color_image.handle() && transformed_depth_image.handle() ){
+            frame_output value;
+            value.frame_number = frame_number;
+            value.timestamp = depth_image.get_device_timestamp();
+            value.transformed_color = k4a::get_mat( transformed_color_image, false );
+            value.transformed_depth = k4a::get_mat( transformed_depth_image, false );
+            output( value );
+        }
+
+        // Release Handles
+        capture.reset();
+        color_image.reset();
+        depth_image.reset();
+        transformed_color_image.reset();
+        transformed_depth_image.reset();
+
+        result.frames++;
+        result.read += transformation_start - read_start;
+        result.transformation += transformation_end - transformation_start;
+    }
+
+    result.total = clock::now() - start;
+    return result;
 }
 
 // Update
-void kinect::update()
+bool kinect::update()
 {
-    // Update Frame
-    update_frame();
+    // Update Frame (Return false at EOF)
+    if( !update_frame() ){
+        return false;
+    }
 
     // Update Color
     update_color();
@@ -145,31 +428,73 @@ void kinect::update()
 
     // Release Capture Handle
     capture.reset();
+
+    return true;
 }
 
 // Update Frame
-inline void kinect::update_frame()
+inline bool kinect::update_frame()
 {
+    k4a::profiler::scoped_timer timer( profiler, profile_update_frame );
+
     // Get Capture Frame
     if( playback_file.empty() ){
         constexpr std::chrono::milliseconds time_out( K4A_WAIT_INFINITE );
-        const bool result = device.get_capture( &capture, time_out );
+        const bool result = source->get_capture( &capture, time_out );
         if( !result ){
             throw k4a::error( "Failed to capture!" );
         }
     }
+    else if( is_dump() ){
+        // Get Capture from Memory Mapped File without Copy
+        if( dump_frame >= dump.size() ){
+            // EOF
+            return false;
+        }
+        capture = dump.get_capture( dump_frame++ );
+    }
+    else if( decode_workers > 0 ){
+        // Start Decoder at First Frame
+        // NOTE: Motion JPEG is decoded on worker threads of decoder, and delivered in timestamp order.
+        if( !decoder ){
+            const k4a::decode_pool::decode_function decode = []( k4a::capture& capture ){
+                k4a::image color_image = capture.get_color_image();
+                return color_image.handle() ? decode_color( color_image ) : cv::Mat();
+            };
+            decoder.reset( new k4a::decode_pool( *source, decode, decode_workers, read_ahead ) );
+        }
+
+        cv::Mat decoded_color;
+        const bool result = decoder->get_next( capture, decoded_color );
+        if( !result ){
+            // EOF
+            return false;
+        }
+
+        // Store Decoded Color to Cache
+        const k4a::image color_image = capture.get_color_image();
+        if( color_image.handle() ){
+            color_cache.put( color_image.get_device_timestamp(), decoded_color );
+        }
+    }
     else{
-        const bool result = playback.get_next_capture( &capture );
+        // NOTE: Playback source returns false at EOF.
+        constexpr std::chrono::milliseconds time_out( K4A_WAIT_INFINITE );
+        const bool result = source->get_capture( &capture, time_out );
         if( !result ){
             // EOF
-            std::exit( EXIT_SUCCESS );
+            return false;
         }
     }
+
+    return true;
 }
 
 // Update Color
 inline void kinect::update_color()
 {
+    k4a::profiler::scoped_timer timer( profiler, profile_update_color );
+
     // Get Color Image
     color_image = capture.get_color_image();
 }
@@ -177,37 +502,56 @@ inline void kinect::update_color()
 // Update Depth
 inline void kinect::update_depth()
 {
+    k4a::profiler::scoped_timer timer( profiler, profile_update_depth );
+
     // Get Depth Image
     depth_image = capture.get_depth_image();
+
+    // Get Timestamps of Frame
+    if( depth_image.handle() ){
+        frame_timestamp        = depth_image.get_device_timestamp();
+        frame_system_timestamp = depth_image.get_system_timestamp();
+    }
 }
 
 // Update Transformation
 inline void kinect::update_transformation()
 {
+    k4a::profiler::scoped_timer timer( profiler, profile_update_transformation );
+
     if( !color_image.handle() || !depth_image.handle() ){
         return;
     }
 
-    if( playback_file.empty() ){
+    if( color_image.get_format() == k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_BGRA32 ){
         // Transform Color Image to Depth Camera
-        transformed_color_image = transformation.color_image_to_depth_camera( depth_image, color_image );
+        transformed_color_image = pool.get_transformed_color_image();
+        transformation.color_image_to_depth_camera( depth_image, color_image, &transformed_color_image );
     }
     else{
-        // Decode Motion JPEG, and Create Color Image from Buffer
-        color = k4a::get_mat( color_image );
+        // Get Decoded Motion JPEG from Cache, and Create Color Image from Buffer
+        // (Transformation of this frame is skipped if color image failed to decode.)
+        color = color_cache.get( color_image );
+        if( color.empty() ){
+            return;
+        }
         k4a::image color_image = k4a::image::create_from_buffer( k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_BGRA32, color.cols, color.rows, static_cast<int32_t>( color.step ), &color.data[0], static_cast<int32_t>( color.total() * color.elemSize() ), nullptr, nullptr );
 
         // Transform Color Image to Depth Camera
-        transformed_color_image = transformation.color_image_to_depth_camera( depth_image, color_image );
+        transformed_color_image = pool.get_transformed_color_image();
+        transformation.color_image_to_depth_camera( depth_image, color_image, &transformed_color_image );
     }
 
     // Transform Depth Image to Color Camera
-    transformed_depth_image = transformation.depth_image_to_color_camera( depth_image );
+    transformed_depth_image = pool.get_transformed_depth_image();
+    transformation.depth_image_to_color_camera( depth_image, &transformed_depth_image );
 }
 
 // Draw
 void kinect::draw()
 {
+    k4a::profiler::scoped_timer timer( profiler, profile_draw );
+
     // Draw Color
     draw_color();
 
@@ -226,7 +570,8 @@ inline void kinect::draw_color()
     }
 
     // Get cv::Mat from k4a::image
-    color = k4a::get_mat( color_image );
+    // NOTE: Color image is decoded only once per frame, decoded cv::Mat is shared with transformation.
+    color = color_cache.get( color_image );
 
     // Release Color Image Handle
     color_image.reset();
@@ -265,6 +610,10 @@ inline void kinect::draw_transformation()
 // Show
 void kinect::show()
 {
+    k4a::profiler::scoped_timer timer( profiler, profile_show );
+
+    windowed = true;
+
     // Show Color
     show_color();
 
@@ -5,6 +5,19 @@
 #include <k4arecord/playback.hpp>
 #include <opencv2/opencv.hpp>
 
+#include "pool.h"
+#include "source.h"
+#include "decoder.h"
+#include "cache.h"
+#include "index.h"
+#include "dump.h"
+#include "profiler.h"
+
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <string>
+
 #if __has_include(<filesystem>)
 #include <filesystem>
 namespace filesystem = std::filesystem;
@@ -19,20 +32,57 @@ namespace filesystem = std::experimental::filesystem;
 
 class kinect
 {
+public:
+    // Statistics of Batch Processing
+    struct statistics
+    {
+        uint64_t frames;
+        std::chrono::duration<double> total;
+        std::chrono::duration<double> read;           // Read (and Decode) Capture
+        std::chrono::duration<double> transformation; // Transform Color and Depth
+    };
+
+    // Output of Frame in Batch Processing
+    // (Images are valid only while output function is called, because they are reused in next frame.)
+    struct frame_output
+    {
+        size_t frame_number;
+        std::chrono::microseconds timestamp;
+        cv::Mat transformed_color;
+        cv::Mat transformed_depth;
+    };
+
+    // Function to Receive Output of Frame
+    using output_function = std::function<void( const frame_output& )>;
+
 private:
     // Kinect
-    k4a::device device;
-    k4a::playback playback;
+    std::unique_ptr<k4a::capture_source> source;
+    k4a::playback_source* playback; // Source of playback file (Owned by source, nullptr for sensor and dump)
     k4a::capture capture;
     k4a::calibration calibration;
     k4a::transformation transformation;
+    k4a::frame_pool pool;
     k4a_device_configuration_t device_configuration;
     uint32_t device_index;
     filesystem::path playback_file;
 
+    // Index
+    k4a::frame_index index;
+
+    // Raw Frame Dump
+    k4a::frame_dump dump;
+    size_t dump_frame;
+
+    // Decoder
+    std::unique_ptr<k4a::decode_pool> decoder;
+    size_t decode_workers;
+    size_t read_ahead;
+
     // Color
     k4a::image color_image;
     cv::Mat color;
+    k4a::frame_cache color_cache;
 
     // Depth
     k4a::image depth_image;
@@ -44,6 +94,16 @@ private:
     cv::Mat transformed_color;
     cv::Mat transformed_depth;
 
+    // Window
+    bool windowed;
+
+    // Profiler (Stages of main loop)
+    enum profile_stage : size_t { profile_update_frame, profile_update_color, profile_update_depth, profile_update_transformation, profile_draw, profile_show };
+    k4a::profiler profiler{ { "update_frame", "update_color", "update_depth", "update_transformation", "draw", "show" } };
+    std::string profile_file;
+    std::chrono::microseconds frame_timestamp;
+    std::chrono::nanoseconds frame_system_timestamp;
+
 public:
     // Constructor
     kinect( const uint32_t index = K4A_DEVICE_DEFAULT );
@@ -54,11 +114,42 @@ public:
     // Destructor
     ~kinect();
 
+    // Configure Decoder for Playback
+    // (workers: number of threads to decode color, read_ahead: number of captures to read ahead (0 is 2 * workers))
+    void configure_decoder( const size_t workers, const size_t read_ahead = 0 );
+
+    // Seek Playback to Device Timestamp
+    // (Next update() gets the first capture at or after timestamp.)
+    void seek( const std::chrono::microseconds timestamp );
+
+    // Get Capture at Frame Number of Playback
+    // (Next update() gets the capture after it.)
+    k4a::capture get_capture_at( const size_t frame_number );
+
+    // Get Number of Captures in Playback
+    size_t get_frame_count();
+
+    // Convert Playback to Raw Frame Dump
+    // (Dump file can be opened by kinect( "file.dump" ), and its frames are read from memory mapped file without decode.)
+    void convert( const filesystem::path& dump_file );
+
+    // Configure Profiler (Call before run())
+    // (Summary is written to *.csv, or trace is written to *.json as Chrome trace JSON when run() is finished.)
+    void configure_profiler( const std::string& file );
+
     // Run
     void run();
 
-    // Update
-    void update();
+    // Run Batch
+    // (Process all frames of playback as fast as possible without window, and return statistics.)
+    statistics run_batch();
+
+    // Run Batch on Range of Frames [begin_frame, end_frame)
+    // (Each frame is passed to output function in order. This is used for processing shards of playback in parallel.)
+    statistics run_batch( const size_t begin_frame, const size_t end_frame, const output_function& output );
+
+    // Update (Return false at EOF of playback)
+    bool update();
 
     // Draw
     void draw();
@@ -76,11 +167,23 @@ private:
     // Initialize Playback
     void initialize_playback();
 
+    // Initialize Dump
+    void initialize_dump();
+
+    // Check Playback File is Raw Frame Dump
+    bool is_dump() const;
+
+    // Seek to Frame Number
+    void seek_frame( const size_t frame_number );
+
     // Finalize
     void finalize();
 
+    // Load Index
+    void load_index();
+
     // Update Frame
-    void update_frame();
+    bool update_frame();
 
     // Update Color
     void update_color();
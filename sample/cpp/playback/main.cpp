@@ -1,11 +1,207 @@
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <fstream>
+#include <chrono>
 
 #include "kinect.hpp"
 
+// Process Files in Batch Mode (Each file is processed concurrently on its own thread)
+int batch( const std::vector<filesystem::path>& files )
+{
+    // Share Cores between Files for Decoding
+    const size_t cores = std::max( 1u, std::thread::hardware_concurrency() );
+    const size_t workers = std::max<size_t>( 1, cores / files.size() );
+
+    std::vector<kinect::statistics> results( files.size() );
+    std::vector<std::string> errors( files.size() );
+    std::vector<std::thread> threads;
+    for( size_t i = 0; i < files.size(); i++ ){
+        threads.emplace_back( [&, i](){
+            try{
+                kinect kinect( files[i] );
+                kinect.configure_decoder( workers );
+                results[i] = kinect.run_batch();
+            }
+            catch( const std::exception& error ){
+                errors[i] = error.what();
+            }
+        } );
+    }
+    for( std::thread& thread : threads ){
+        thread.join();
+    }
+
+    // Show Statistics
+    int32_t status = 0;
+    for( size_t i = 0; i < files.size(); i++ ){
+        std::cout << files[i].generic_string() << std::endl;
+        if( !errors[i].empty() ){
+            std::cout << "  error          : " << errors[i] << std::endl;
+            status = -1;
+            continue;
+        }
+
+        const kinect::statistics& result = results[i];
+        const double frames = static_cast<double>( std::max<uint64_t>( result.frames, 1 ) );
+        std::cout << "  frames         : " << result.frames << std::endl;
+        std::cout << "  total          : " << result.total.count() << " s (" << result.frames / result.total.count() << " fps)" << std::endl;
+        std::cout << "  read           : " << result.read.count() * 1000.0 / frames << " ms/frame" << std::endl;
+        std::cout << "  transformation : " << result.transformation.count() * 1000.0 / frames << " ms/frame" << std::endl;
+    }
+
+    return status;
+}
+
+// Process File in Sharded Mode (File is split into shards by frames, and each shard is processed concurrently on its own thread)
+int sharded( const filesystem::path& file, const size_t shards, const filesystem::path& output_file )
+{
+    // Get Number of Frames (Index is built at first time, and shared with shards by index file)
+    size_t frame_count = 0;
+    {
+        kinect kinect( file );
+        frame_count = kinect.get_frame_count();
+    }
+
+    // Summary of Frame
+    struct summary
+    {
+        size_t frame_number;
+        int64_t timestamp;
+        int32_t valid_pixels;
+    };
+
+    // Share Cores between Shards for Decoding
+    const size_t cores = std::max( 1u, std::thread::hardware_concurrency() );
+    const size_t workers = std::max<size_t>( 1, cores / shards );
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<kinect::statistics> results( shards );
+    std::vector<std::vector<summary>> outputs( shards );
+    std::vector<std::string> errors( shards );
+    std::vector<std::thread> threads;
+    for( size_t i = 0; i < shards; i++ ){
+        threads.emplace_back( [&, i](){
+            try{
+                const size_t begin_frame = frame_count * i / shards;
+                const size_t end_frame = frame_count * ( i + 1 ) / shards;
+
+                kinect kinect( file );
+                kinect.configure_decoder( workers );
+                results[i] = kinect.run_batch( begin_frame, end_frame, [&]( const kinect::frame_output& output ){
+                    outputs[i].push_back( { output.frame_number, static_cast<int64_t>( output.timestamp.count() ), cv::countNonZero( output.transformed_depth ) } );
+                } );
+            }
+            catch( const std::exception& error ){
+                errors[i] = error.what();
+            }
+        } );
+    }
+    for( std::thread& thread : threads ){
+        thread.join();
+    }
+    const double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+    // Show Statistics
+    int32_t status = 0;
+    uint64_t frames = 0;
+    for( size_t i = 0; i < shards; i++ ){
+        if( !errors[i].empty() ){
+            std::cout << "shard " << i << " error : " << errors[i] << std::endl;
+            status = -1;
+            continue;
+        }
+        std::cout << "shard " << i << " : " << results[i].frames << " frames (" << results[i].frames / results[i].total.count() << " fps)" << std::endl;
+        frames += results[i].frames;
+    }
+    std::cout << "total   : " << frames << " frames (" << frames / seconds << " fps)" << std::endl;
+
+    // Merge Outputs of Shards in Order
+    if( !output_file.empty() ){
+        std::ofstream stream( output_file.generic_string() );
+        stream << "frame,timestamp,valid_pixels" << std::endl;
+        for( const std::vector<summary>& output : outputs ){
+            for( const summary& value : output ){
+                stream << value.frame_number << "," << value.timestamp << "," << value.valid_pixels << "\n";
+            }
+        }
+    }
+
+    return status;
+}
+
+// Show Usage (Return error code of invalid options)
+int usage( const char* name )
+{
+    std::cout << "usage: " << name << " [--batch] [--shards <N>] [--output <csv>] [--convert <dump>] [--profile <csv|json>] [file ...]" << std::endl;
+    return -1;
+}
+
 int main( int argc, char* argv[] )
 {
+    // Parse Options
+    // playback [--batch] [--shards <N>] [--output <csv>] [--convert <dump>] [--profile <csv|json>] [file ...]
+    // (file can be playback file (*.mkv) or raw frame dump (*.dump) that was converted by --convert)
+    bool batch_mode = false;
+    filesystem::path dump_file;
+    size_t shards = 0;
+    filesystem::path output_file;
+    std::string profile_file;
+    std::vector<filesystem::path> files;
+    try{
+        for( int32_t i = 1; i < argc; i++ ){
+            const std::string option = argv[i];
+            if( option == "--batch" ){
+                batch_mode = true;
+            }
+            else if( option == "--shards" && i + 1 < argc ){
+                shards = static_cast<size_t>( std::stoul( argv[++i] ) );
+            }
+            else if( option == "--convert" && i + 1 < argc ){
+                dump_file = argv[++i];
+            }
+            else if( option == "--output" && i + 1 < argc ){
+                output_file = argv[++i];
+            }
+            else if( option == "--profile" && i + 1 < argc ){
+                profile_file = argv[++i];
+            }
+            else if( option.compare( 0, 2, "--" ) != 0 ){
+                files.push_back( option );
+            }
+            else{
+                // Unknown Option, or Option without Value
+                return usage( argv[0] );
+            }
+        }
+    }
+    catch( const std::exception& ){
+        // Value of Option is not Number (std::invalid_argument), or Out of Range (std::out_of_range)
+        return usage( argv[0] );
+    }
+
     try{
+        if( files.empty() ){
+            files.push_back( "../file.mkv" );
+        }
+
+        if( !dump_file.empty() ){
+            kinect kinect( files.front() );
+            kinect.convert( dump_file );
+            return 0;
+        }
+
+        if( shards > 0 ){
+            return sharded( files.front(), shards, output_file );
+        }
+
+        if( batch_mode ){
+            return batch( files );
+        }
+
         /*
         // Sensor
         const uint32_t index = K4A_DEVICE_DEFAULT;
@@ -13,9 +209,15 @@ int main( int argc, char* argv[] )
         */
         ///*
         // File
-        const filesystem::path file = "../file.mkv";
+        const filesystem::path file = files.front();
         kinect kinect( file );
         //*/
+
+        // Profiler (Summary as CSV, or Trace as Chrome Trace JSON)
+        if( !profile_file.empty() ){
+            kinect.configure_profiler( profile_file );
+        }
+
         kinect.run();
     }
     catch( const k4a::error& error ){
@@ -23,4 +225,4 @@ int main( int argc, char* argv[] )
     }
 
     return 0;
-}
\ No newline at end of file
+}
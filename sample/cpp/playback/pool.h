@@ -0,0 +1,115 @@
+/*
+ This is utility to that provides pool of output images for k4a::transformation.
+ The output images are allocated once per calibration, and reused in every frame.
+
+ k4a::frame_pool pool( calibration );
+ k4a::image transformed_depth_image = pool.get_transformed_depth_image();
+ transformation.depth_image_to_color_camera( depth_image, &transformed_depth_image );
+
+ Copyright (c) 2019 Tsukasa Sugiura <t.sugiura0204@gmail.com>
+ Licensed under the MIT license.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef __POOL__
+#define __POOL__
+
+#include <k4a/k4a.h>
+#include <k4a/k4a.hpp>
+
+namespace k4a
+{
+    class frame_pool
+    {
+    private:
+        k4a::calibration calibration;
+
+        // Depth Image in Color Camera Geometry
+        k4a::image transformed_depth_image;
+
+        // Color Image in Depth Camera Geometry
+        k4a::image transformed_color_image;
+
+        // Point Cloud in Depth/Color Camera Geometry
+        k4a::image depth_xyz_image;
+        k4a::image color_xyz_image;
+
+    public:
+        frame_pool() = default;
+
+        frame_pool( const k4a::calibration& calibration )
+        {
+            reset( calibration );
+        }
+
+        // Reset Pool with Calibration
+        // (Images are allocated at the first request, and reused until next reset.)
+        void reset( const k4a::calibration& calibration )
+        {
+            this->calibration = calibration;
+            transformed_depth_image.reset();
+            transformed_color_image.reset();
+            depth_xyz_image.reset();
+            color_xyz_image.reset();
+        }
+
+        // Get Depth Image for k4a::transformation::depth_image_to_color_camera()
+        k4a::image get_transformed_depth_image()
+        {
+            if( !transformed_depth_image.handle() ){
+                const k4a_calibration_camera_t& camera = calibration.color_camera_calibration;
+                transformed_depth_image = create( k4a_image_format_t::K4A_IMAGE_FORMAT_DEPTH16, camera, sizeof( uint16_t ) );
+            }
+            return transformed_depth_image;
+        }
+
+        // Get Color Image for k4a::transformation::color_image_to_depth_camera()
+        k4a::image get_transformed_color_image()
+        {
+            if( !transformed_color_image.handle() ){
+                const k4a_calibration_camera_t& camera = calibration.depth_camera_calibration;
+                transformed_color_image = create( k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_BGRA32, camera, 4 * sizeof( uint8_t ) );
+            }
+            return transformed_color_image;
+        }
+
+        // Get Point Cloud Image for k4a::transformation::depth_image_to_point_cloud()
+        k4a::image get_xyz_image( const k4a_calibration_type_t type )
+        {
+            k4a::image& xyz_image = ( type == k4a_calibration_type_t::K4A_CALIBRATION_TYPE_COLOR ) ? color_xyz_image : depth_xyz_image;
+            if( !xyz_image.handle() ){
+                const k4a_calibration_camera_t& camera = ( type == k4a_calibration_type_t::K4A_CALIBRATION_TYPE_COLOR ) ? calibration.color_camera_calibration : calibration.depth_camera_calibration;
+                xyz_image = create( k4a_image_format_t::K4A_IMAGE_FORMAT_CUSTOM, camera, 3 * sizeof( int16_t ) );
+            }
+            return xyz_image;
+        }
+
+    private:
+        static k4a::image create( const k4a_image_format_t format, const k4a_calibration_camera_t& camera, const size_t pixel_bytes )
+        {
+            const int32_t width  = camera.resolution_width;
+            const int32_t height = camera.resolution_height;
+            const int32_t stride_bytes = width * static_cast<int32_t>( pixel_bytes );
+            return k4a::image::create( format, width, height, stride_bytes );
+        }
+    };
+}
+
+#endif // __POOL__
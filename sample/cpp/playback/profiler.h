@@ -0,0 +1,397 @@
+/*
+ This is utility to that provides lightweight instrumentation of stages in main loop or pipeline.
+ Durations are recorded into fixed-size lock-free histogram per stage, so stages can be timed from any threads.
+
+ enum stage { update, draw, show };
+ k4a::profiler profiler( { "update", "draw", "show" } );
+ {
+     k4a::profiler::scoped_timer timer( profiler, stage::update ); // duration of scope is recorded
+     update();
+ }
+ profiler.record_latency( image.get_device_timestamp(), image.get_system_timestamp(), k4a::profiler::clock::now() ); // sensor to display
+ profiler.print( std::cout ); // p50/p95/p99 of each stage
+ profiler.write( "profile.csv" );  // summary as CSV
+ profiler.write( "profile.json" ); // trace as Chrome trace JSON (chrome://tracing) (need to enable_trace())
+
+ Copyright (c) 2019 Tsukasa Sugiura <t.sugiura0204@gmail.com>
+ Licensed under the MIT license.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef __PROFILER__
+#define __PROFILER__
+
+#include <k4a/k4a.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <limits>
+#include <fstream>
+#include <ostream>
+#include <iomanip>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+
+namespace k4a
+{
+    // Fixed-Size Lock-Free Histogram of Durations
+    // Buckets are log-linear (16 sub-buckets per power of two nanoseconds), so relative error of percentile is less than 6.25%.
+    class latency_histogram
+    {
+    private:
+        static const uint32_t sub_bucket_bits = 4;
+        static const uint32_t sub_bucket_count = 1 << sub_bucket_bits;
+        static const uint32_t max_bits = 40; // Up to about 18 minutes
+        static const uint32_t bucket_count = ( max_bits - sub_bucket_bits + 1 ) * sub_bucket_count;
+
+        std::atomic<uint64_t> buckets[bucket_count];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+
+    public:
+        latency_histogram()
+        {
+            reset();
+        }
+
+        // Reset (Not thread-safe with record())
+        void reset()
+        {
+            for( std::atomic<uint64_t>& bucket : buckets ){
+                bucket.store( 0, std::memory_order_relaxed );
+            }
+            count.store( 0, std::memory_order_relaxed );
+            sum.store( 0, std::memory_order_relaxed );
+            max.store( 0, std::memory_order_relaxed );
+        }
+
+        // Record Duration (Lock-free, and can be called from any threads)
+        void record( const std::chrono::nanoseconds duration )
+        {
+            const uint64_t value = static_cast<uint64_t>( std::max<int64_t>( duration.count(), 0 ) );
+            buckets[get_index( value )].fetch_add( 1, std::memory_order_relaxed );
+            count.fetch_add( 1, std::memory_order_relaxed );
+            sum.fetch_add( value, std::memory_order_relaxed );
+
+            uint64_t current = max.load( std::memory_order_relaxed );
+            while( value > current && !max.compare_exchange_weak( current, value, std::memory_order_relaxed ) ){
+            }
+        }
+
+        // Get Number of Recorded Durations
+        uint64_t get_count() const
+        {
+            return count.load( std::memory_order_relaxed );
+        }
+
+        // Get Mean of Durations
+        std::chrono::nanoseconds get_mean() const
+        {
+            const uint64_t n = get_count();
+            return std::chrono::nanoseconds( n > 0 ? static_cast<int64_t>( sum.load( std::memory_order_relaxed ) / n ) : 0 );
+        }
+
+        // Get Max of Durations
+        std::chrono::nanoseconds get_max() const
+        {
+            return std::chrono::nanoseconds( static_cast<int64_t>( max.load( std::memory_order_relaxed ) ) );
+        }
+
+        // Get Percentile of Durations (percentile is [0.0, 100.0])
+        std::chrono::nanoseconds get_percentile( const double percentile ) const
+        {
+            const uint64_t n = get_count();
+            if( n == 0 ){
+                return std::chrono::nanoseconds( 0 );
+            }
+
+            // Find Bucket that Contains Rank, and Return Middle of Bucket (Not exceed Max)
+            const uint64_t rank = std::max<uint64_t>( static_cast<uint64_t>( percentile / 100.0 * n + 0.5 ), 1 );
+            uint64_t accumulated = 0;
+            for( uint32_t i = 0; i < bucket_count; i++ ){
+                accumulated += buckets[i].load( std::memory_order_relaxed );
+                if( accumulated >= rank ){
+                    const uint64_t middle = ( get_lower_bound( i ) + get_upper_bound( i ) ) / 2;
+                    return std::min( std::chrono::nanoseconds( static_cast<int64_t>( middle ) ), get_max() );
+                }
+            }
+            return get_max();
+        }
+
+    private:
+        // Get Index of Bucket for Value
+        static uint32_t get_index( uint64_t value )
+        {
+            value = std::min<uint64_t>( value, ( uint64_t( 1 ) << max_bits ) - 1 );
+            if( value < sub_bucket_count ){
+                return static_cast<uint32_t>( value );
+            }
+
+            uint32_t msb = 0;
+            for( uint64_t v = value; v >>= 1; ){
+                msb++;
+            }
+            const uint32_t exponent = msb - sub_bucket_bits;
+            const uint32_t mantissa = static_cast<uint32_t>( value >> exponent ) - sub_bucket_count;
+            return ( exponent + 1 ) * sub_bucket_count + mantissa;
+        }
+
+        // Get Lower Bound of Bucket
+        static uint64_t get_lower_bound( const uint32_t index )
+        {
+            if( index < sub_bucket_count ){
+                return index;
+            }
+            const uint32_t exponent = index / sub_bucket_count - 1;
+            const uint64_t mantissa = index % sub_bucket_count + sub_bucket_count;
+            return mantissa << exponent;
+        }
+
+        // Get Upper Bound of Bucket
+        static uint64_t get_upper_bound( const uint32_t index )
+        {
+            if( index < sub_bucket_count ){
+                return index;
+            }
+            const uint32_t exponent = index / sub_bucket_count - 1;
+            const uint64_t mantissa = index % sub_bucket_count + sub_bucket_count;
+            return ( ( mantissa + 1 ) << exponent ) - 1;
+        }
+    };
+
+    class profiler
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        // Scoped Timer (Record duration from construction to destruction to stage)
+        class scoped_timer
+        {
+        private:
+            profiler& owner;
+            const size_t stage;
+            const clock::time_point begin;
+
+        public:
+            scoped_timer( profiler& owner, const size_t stage )
+                : owner( owner ),
+                  stage( stage ),
+                  begin( clock::now() )
+            {
+            }
+
+            ~scoped_timer()
+            {
+                owner.record( stage, begin, clock::now() );
+            }
+
+            scoped_timer( const scoped_timer& ) = delete;
+            scoped_timer& operator=( const scoped_timer& ) = delete;
+        };
+
+    private:
+        // Event of Trace
+        struct trace_event
+        {
+            uint32_t stage;
+            uint32_t thread;
+            int64_t begin;    // Nanoseconds from epoch of profiler
+            int64_t duration; // Nanoseconds
+        };
+
+        std::vector<std::string> names;
+        std::unique_ptr<latency_histogram[]> histograms;
+        latency_histogram latency;
+        std::atomic<int64_t> clock_offset;
+        const clock::time_point epoch;
+
+        std::unique_ptr<trace_event[]> events;
+        size_t event_capacity;
+        std::atomic<size_t> event_count;
+
+    public:
+        // Constructor (Names of stages, stage is specified by index of name)
+        profiler( const std::vector<std::string>& stages )
+            : names( stages ),
+              histograms( new latency_histogram[stages.size()] ),
+              clock_offset( std::numeric_limits<int64_t>::max() ),
+              epoch( clock::now() ),
+              event_capacity( 0 ),
+              event_count( 0 )
+        {
+        }
+
+        // Enable Trace (Keep events up to capacity for Chrome trace JSON. Call before recording.)
+        void enable_trace( const size_t capacity )
+        {
+            events.reset( new trace_event[capacity] );
+            event_capacity = capacity;
+            event_count = 0;
+        }
+
+        // Record Duration of Stage (Lock-free, and can be called from any threads)
+        void record( const size_t stage, const clock::time_point begin, const clock::time_point end )
+        {
+            histograms[stage].record( end - begin );
+
+            if( event_capacity == 0 ){
+                return;
+            }
+
+            // Events after capacity are dropped
+            const size_t index = event_count.fetch_add( 1, std::memory_order_relaxed );
+            if( index < event_capacity ){
+                trace_event& event = events[index];
+                event.stage    = static_cast<uint32_t>( stage );
+                event.thread   = static_cast<uint32_t>( std::hash<std::thread::id>()( std::this_thread::get_id() ) );
+                event.begin    = std::chrono::duration_cast<std::chrono::nanoseconds>( begin - epoch ).count();
+                event.duration = std::chrono::duration_cast<std::chrono::nanoseconds>( end - begin ).count();
+            }
+        }
+
+        // Record End-to-End Latency from Sensor to Display of Frame
+        // Device timestamp is not on clock of host, so it is aligned to host by the smallest difference between them that has been observed.
+        // (System timestamp (arrival of image at host) is used for alignment if it is available, otherwise displayed time is used.)
+        // NOTE: The latency is relative to the fastest frame, it doesn't include the constant delay of exposure and transfer of the fastest frame.
+        void record_latency( const std::chrono::microseconds device_timestamp, const std::chrono::nanoseconds system_timestamp, const clock::time_point displayed )
+        {
+            const int64_t device = std::chrono::duration_cast<std::chrono::nanoseconds>( device_timestamp ).count();
+            const int64_t display = std::chrono::duration_cast<std::chrono::nanoseconds>( displayed.time_since_epoch() ).count();
+            const int64_t reference = ( system_timestamp.count() > 0 ) ? system_timestamp.count() : display;
+
+            int64_t offset = clock_offset.load( std::memory_order_relaxed );
+            while( reference - device < offset && !clock_offset.compare_exchange_weak( offset, reference - device, std::memory_order_relaxed ) ){
+            }
+            offset = std::min( offset, reference - device );
+
+            latency.record( std::chrono::nanoseconds( display - ( device + offset ) ) );
+        }
+
+        // Get Histogram of Stage
+        const latency_histogram& get_histogram( const size_t stage ) const
+        {
+            return histograms[stage];
+        }
+
+        // Get Histogram of End-to-End Latency
+        const latency_histogram& get_latency() const
+        {
+            return latency;
+        }
+
+        // Print Summary (Milliseconds)
+        void print( std::ostream& stream ) const
+        {
+            stream << std::setw( 24 ) << std::left << "stage" << std::right
+                   << std::setw( 10 ) << "count"
+                   << std::setw( 10 ) << "mean"
+                   << std::setw( 10 ) << "p50"
+                   << std::setw( 10 ) << "p95"
+                   << std::setw( 10 ) << "p99"
+                   << std::setw( 10 ) << "max" << " (ms)" << std::endl;
+            for( size_t i = 0; i < names.size(); i++ ){
+                print( stream, names[i], histograms[i] );
+            }
+            if( latency.get_count() > 0 ){
+                print( stream, "sensor to display", latency );
+            }
+        }
+
+        // Write Summary as CSV (*.csv) or Trace as Chrome Trace JSON (*.json)
+        void write( const std::string& file ) const
+        {
+            std::ofstream stream( file );
+            if( !stream.is_open() ){
+                throw k4a::error( "Failed to open profile file!" );
+            }
+
+            const std::string json = ".json";
+            if( file.size() >= json.size() && file.compare( file.size() - json.size(), json.size(), json ) == 0 ){
+                write_trace( stream );
+            }
+            else{
+                write_csv( stream );
+            }
+        }
+
+    private:
+        // Print Summary of Histogram
+        static void print( std::ostream& stream, const std::string& name, const latency_histogram& histogram )
+        {
+            stream << std::setw( 24 ) << std::left << name << std::right
+                   << std::setw( 10 ) << histogram.get_count() << std::fixed << std::setprecision( 3 )
+                   << std::setw( 10 ) << to_milliseconds( histogram.get_mean() )
+                   << std::setw( 10 ) << to_milliseconds( histogram.get_percentile( 50.0 ) )
+                   << std::setw( 10 ) << to_milliseconds( histogram.get_percentile( 95.0 ) )
+                   << std::setw( 10 ) << to_milliseconds( histogram.get_percentile( 99.0 ) )
+                   << std::setw( 10 ) << to_milliseconds( histogram.get_max() ) << std::endl;
+        }
+
+        // Write Summary as CSV
+        void write_csv( std::ostream& stream ) const
+        {
+            stream << "stage,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms" << std::endl;
+            for( size_t i = 0; i < names.size(); i++ ){
+                write_csv( stream, names[i], histograms[i] );
+            }
+            write_csv( stream, "sensor to display", latency );
+        }
+
+        // Write Summary of Histogram as CSV
+        static void write_csv( std::ostream& stream, const std::string& name, const latency_histogram& histogram )
+        {
+            stream << name << "," << histogram.get_count() << std::fixed << std::setprecision( 3 )
+                   << "," << to_milliseconds( histogram.get_mean() )
+                   << "," << to_milliseconds( histogram.get_percentile( 50.0 ) )
+                   << "," << to_milliseconds( histogram.get_percentile( 95.0 ) )
+                   << "," << to_milliseconds( histogram.get_percentile( 99.0 ) )
+                   << "," << to_milliseconds( histogram.get_max() ) << "\n";
+        }
+
+        // Write Trace as Chrome Trace JSON (Complete events, timestamps are microseconds)
+        void write_trace( std::ostream& stream ) const
+        {
+            const size_t count = std::min( event_count.load(), event_capacity );
+            stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+            stream << std::fixed << std::setprecision( 3 );
+            for( size_t i = 0; i < count; i++ ){
+                const trace_event& event = events[i];
+                stream << ( i > 0 ? ",\n" : "\n" )
+                       << "{\"name\":\"" << names[event.stage] << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread
+                       << ",\"ts\":" << event.begin / 1000.0 << ",\"dur\":" << event.duration / 1000.0 << "}";
+            }
+            stream << "\n]}" << std::endl;
+        }
+
+        // Convert Duration to Milliseconds
+        static double to_milliseconds( const std::chrono::nanoseconds duration )
+        {
+            return std::chrono::duration<double, std::milli>( duration ).count();
+        }
+    };
+}
+
+#endif // __PROFILER__
@@ -0,0 +1,561 @@
+/*
+ This is utility to that provides compact encoding of organized point cloud for storage and transport.
+ Organized point cloud is derived from depth image and table of rays, so frame stores only depth image (and color image) with ID of calibration,
+ and point cloud is reconstructed on decode with table of rays of registered calibration.
+
+ // Encode
+ k4a::cloud_encoder encoder( k4a::codec::compression::delta_rle );
+ std::vector<uint8_t> frame;
+ encoder.encode( calibration, K4A_CALIBRATION_TYPE_COLOR, transformed_depth_image, color_image, frame ); // color_image is BGRA or MJPG of same size, or empty
+ k4a::codec::write_calibration( k4a::codec::get_calibration_file( calibration ), calibration ); // calibration_<id>.bin (once per calibration)
+
+ // Decode
+ k4a::cloud_decoder decoder;
+ decoder.load_calibration( k4a::codec::get_calibration_file( k4a::codec::read_header( frame.data(), frame.size() ).calibration_id ) );
+ decoder.decode( frame.data(), frame.size(), xyz, color ); // cv::Mat (CV_32FC3, invalid points are NaN), and color is BGRA (shared with frame without copy if it is not MJPG)
+
+ Depth is compressed losslessly with delta and run length coding (compression::delta_rle).
+ Each row is coded independently, so rows are encoded and decoded in parallel on thread pool of OpenCV (cv::parallel_for_).
+ Residual from previous valid pixel in row and run of invalid pixels are coded into byte-aligned tokens.
+
+ 0x00-0x7F : residual -64..63
+ 0x80-0xBF : run of 1..64 invalid pixels
+ 0xC0-0xDF : residual -4096..4095 (with next byte)
+ 0xE0      : literal depth (next 2 bytes)
+ 0xE1      : run of invalid pixels (next 2 bytes)
+
+ Color is stored as is. MJPG of device is kept without re-encode, so use MJPG color to reduce size of frames (BGRA is 3.6 MB per frame at 720p).
+ Calibration is not stored in frames. Write it to file once (codec::write_calibration()), and load it to decoder (cloud_decoder::load_calibration()).
+
+ Copyright (c) 2019 Tsukasa Sugiura <t.sugiura0204@gmail.com>
+ Licensed under the MIT license.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef __CODEC__
+#define __CODEC__
+
+#include <k4a/k4a.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "unprojection.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+namespace k4a
+{
+    namespace codec
+    {
+        static const char magic[4] = { 'K', '4', 'D', 'C' };
+        static const uint16_t version = 1;
+        static const char calibration_magic[4] = { 'K', '4', 'C', 'B' };
+
+        // Compression of Depth
+        enum class compression : uint16_t
+        {
+            raw       = 0, // Rows of depth as is
+            delta_rle = 1  // Delta and run length coding (lossless)
+        };
+
+        // Format of Color
+        enum class color_format : uint32_t
+        {
+            bgra = 0, // Rows of BGRA as is
+            mjpg = 1  // Motion JPEG of device as is
+        };
+
+        // Header of Frame
+        // Frame is [header][depth][color], and depth of delta_rle is [offsets of rows (height + 1)][rows].
+        struct header
+        {
+            char magic[4];
+            uint16_t version;
+            uint16_t compression;
+            uint64_t calibration_id;   // ID of calibration (get_calibration_id())
+            int32_t calibration_type;  // Camera of depth image (k4a_calibration_type_t)
+            int32_t width;
+            int32_t height;
+            uint32_t depth_size;       // Bytes of depth
+            uint32_t color_size;       // Bytes of color, 0 if color doesn't exist
+            uint32_t color_format;     // Format of color (codec::color_format)
+            int64_t timestamp;         // Device timestamp of depth image (usec)
+        };
+
+        // Get ID of Calibration (FNV-1a hash of calibration)
+        inline uint64_t get_calibration_id( const k4a::calibration& calibration )
+        {
+            const k4a_calibration_t& value = calibration;
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>( &value );
+            uint64_t hash = 0xCBF29CE484222325ull;
+            for( size_t i = 0; i < sizeof( k4a_calibration_t ); i++ ){
+                hash = ( hash ^ bytes[i] ) * 0x100000001B3ull;
+            }
+            return hash;
+        }
+
+        // Get File Name of Calibration (calibration_<id>.bin)
+        inline std::string get_calibration_file( const uint64_t id )
+        {
+            std::ostringstream name;
+            name << "calibration_" << std::hex << std::setw( 16 ) << std::setfill( '0' ) << id << ".bin";
+            return name.str();
+        }
+
+        inline std::string get_calibration_file( const k4a::calibration& calibration )
+        {
+            return get_calibration_file( get_calibration_id( calibration ) );
+        }
+
+        // Write Calibration to File
+        // File is [magic][size][k4a_calibration_t], so ID of calibration is same as it was encoded.
+        inline void write_calibration( const std::string& path, const k4a::calibration& calibration )
+        {
+            std::ofstream stream( path, std::ios::binary | std::ios::trunc );
+            if( !stream.is_open() ){
+                throw k4a::error( "Failed to open calibration file!" );
+            }
+            const k4a_calibration_t& value = calibration;
+            const uint32_t size = static_cast<uint32_t>( sizeof( k4a_calibration_t ) );
+            stream.write( calibration_magic, sizeof( calibration_magic ) );
+            stream.write( reinterpret_cast<const char*>( &size ), sizeof( uint32_t ) );
+            stream.write( reinterpret_cast<const char*>( &value ), sizeof( k4a_calibration_t ) );
+            if( !stream ){
+                throw k4a::error( "Failed to write calibration file!" );
+            }
+        }
+
+        // Read Calibration from File
+        inline k4a::calibration read_calibration( const std::string& path )
+        {
+            std::ifstream stream( path, std::ios::binary );
+            if( !stream.is_open() ){
+                throw k4a::error( "Failed to open calibration file! (" + path + ")" );
+            }
+            char magic[4];
+            uint32_t size = 0;
+            stream.read( magic, sizeof( magic ) );
+            stream.read( reinterpret_cast<char*>( &size ), sizeof( uint32_t ) );
+            if( !stream || std::memcmp( magic, calibration_magic, sizeof( magic ) ) != 0 || size != sizeof( k4a_calibration_t ) ){
+                throw k4a::error( "Failed to read calibration file! (invalid header)" );
+            }
+            k4a::calibration calibration;
+            k4a_calibration_t& value = calibration;
+            stream.read( reinterpret_cast<char*>( &value ), sizeof( k4a_calibration_t ) );
+            if( !stream ){
+                throw k4a::error( "Failed to read calibration file! (file is too small)" );
+            }
+            return calibration;
+        }
+
+        // Read Header of Frame
+        inline header read_header( const uint8_t* data, const size_t size )
+        {
+            header value;
+            if( size < sizeof( header ) ){
+                throw k4a::error( "Failed to decode frame! (frame is too small)" );
+            }
+            std::memcpy( &value, data, sizeof( header ) );
+            if( std::memcmp( value.magic, magic, sizeof( magic ) ) != 0 || value.version != version ){
+                throw k4a::error( "Failed to decode frame! (invalid header)" );
+            }
+            if( value.width <= 0 || value.height <= 0 || sizeof( header ) + static_cast<uint64_t>( value.depth_size ) + value.color_size > size ){
+                throw k4a::error( "Failed to decode frame! (invalid size)" );
+            }
+            return value;
+        }
+
+        // Maximum Bytes of Encoded Row (Literal is 3 bytes per pixel)
+        inline size_t get_max_row_size( const int32_t width )
+        {
+            return static_cast<size_t>( width ) * 3;
+        }
+
+        // Encode Row of Depth (Return bytes of encoded row)
+        inline size_t encode_row( const uint16_t* depth, const int32_t width, uint8_t* dst )
+        {
+            uint8_t* token = dst;
+            int32_t previous = 0;
+            int32_t x = 0;
+            while( x < width ){
+                // Run of Invalid Pixels
+                if( depth[x] == 0 ){
+                    int32_t run = 1;
+                    while( x + run < width && depth[x + run] == 0 && run < 0xFFFF ){
+                        run++;
+                    }
+                    if( run <= 64 ){
+                        *token++ = static_cast<uint8_t>( 0x7F + run );
+                    }
+                    else{
+                        *token++ = 0xE1;
+                        *token++ = static_cast<uint8_t>( run & 0xFF );
+                        *token++ = static_cast<uint8_t>( run >> 8 );
+                    }
+                    x += run;
+                    continue;
+                }
+
+                // Residual from Previous Valid Pixel
+                const int32_t value = depth[x];
+                const int32_t residual = value - previous;
+                if( -64 <= residual && residual < 64 ){
+                    *token++ = static_cast<uint8_t>( residual + 64 );
+                }
+                else if( -4096 <= residual && residual < 4096 ){
+                    const int32_t biased = residual + 4096;
+                    *token++ = static_cast<uint8_t>( 0xC0 | ( biased >> 8 ) );
+                    *token++ = static_cast<uint8_t>( biased & 0xFF );
+                }
+                else{
+                    *token++ = 0xE0;
+                    *token++ = static_cast<uint8_t>( value & 0xFF );
+                    *token++ = static_cast<uint8_t>( value >> 8 );
+                }
+                previous = value;
+                x++;
+            }
+            return static_cast<size_t>( token - dst );
+        }
+
+        // Decode Row of Depth (Return false if row is corrupted)
+        inline bool decode_row( const uint8_t* src, const uint8_t* end, uint16_t* depth, const int32_t width )
+        {
+            int32_t previous = 0;
+            int32_t x = 0;
+            while( x < width ){
+                if( src >= end ){
+                    return false;
+                }
+
+                const uint8_t token = *src++;
+                if( token < 0x80 ){
+                    previous += token - 64;
+                    depth[x++] = static_cast<uint16_t>( previous );
+                }
+                else if( token < 0xC0 ){
+                    const int32_t run = token - 0x7F;
+                    if( x + run > width ){
+                        return false;
+                    }
+                    std::fill( depth + x, depth + x + run, static_cast<uint16_t>( 0 ) );
+                    x += run;
+                }
+                else if( token < 0xE0 ){
+                    if( src >= end ){
+                        return false;
+                    }
+                    previous += ( ( ( token - 0xC0 ) << 8 ) | *src++ ) - 4096;
+                    depth[x++] = static_cast<uint16_t>( previous );
+                }
+                else if( token <= 0xE1 ){
+                    if( end - src < 2 ){
+                        return false;
+                    }
+                    const int32_t value = src[0] | ( src[1] << 8 );
+                    src += 2;
+                    if( token == 0xE0 ){
+                        previous = value;
+                        depth[x++] = static_cast<uint16_t>( value );
+                        continue;
+                    }
+                    if( x + value > width ){
+                        return false;
+                    }
+                    std::fill( depth + x, depth + x + value, static_cast<uint16_t>( 0 ) );
+                    x += value;
+                }
+                else{
+                    return false;
+                }
+            }
+            return src == end;
+        }
+    }
+
+    class cloud_encoder
+    {
+    private:
+        codec::compression compression;
+
+        // Encoded Rows and their Sizes (Reused in every frame)
+        std::vector<uint8_t> rows;
+        std::vector<uint32_t> sizes;
+
+    public:
+        cloud_encoder( const codec::compression compression = codec::compression::delta_rle )
+            : compression( compression )
+        {
+        }
+
+        // Encode Frame
+        // (depth_image is DEPTH16 in camera of type, color_image is BGRA or MJPG of same size, or empty. Capacity of frame is reused.)
+        // (MJPG is stored as is without decode, so it is much smaller than BGRA.)
+        void encode( const k4a::calibration& calibration, const k4a_calibration_type_t type, const k4a::image& depth_image, const k4a::image& color_image, std::vector<uint8_t>& frame )
+        {
+            const int32_t width = depth_image.get_width_pixels();
+            const int32_t height = depth_image.get_height_pixels();
+            const bool has_color = color_image.handle() != nullptr;
+            const bool is_mjpg = has_color && color_image.get_format() == K4A_IMAGE_FORMAT_COLOR_MJPG;
+            if( has_color && ( ( !is_mjpg && color_image.get_format() != K4A_IMAGE_FORMAT_COLOR_BGRA32 ) || color_image.get_width_pixels() != width || color_image.get_height_pixels() != height ) ){
+                throw k4a::error( "Failed to encode frame! (color image must be BGRA or MJPG image of same size as depth image)" );
+            }
+
+            // Encode Rows of Depth in Parallel
+            const size_t row_size = static_cast<size_t>( width ) * sizeof( uint16_t );
+            size_t depth_size = row_size * height;
+            if( compression == codec::compression::delta_rle ){
+                const size_t max_row_size = codec::get_max_row_size( width );
+                rows.resize( max_row_size * height );
+                sizes.resize( static_cast<size_t>( height ) );
+                cv::parallel_for_( cv::Range( 0, height ), [&]( const cv::Range& range ){
+                    for( int32_t y = range.start; y < range.end; y++ ){
+                        const uint16_t* depth = reinterpret_cast<const uint16_t*>( depth_image.get_buffer() + static_cast<size_t>( y ) * depth_image.get_stride_bytes() );
+                        sizes[y] = static_cast<uint32_t>( codec::encode_row( depth, width, &rows[max_row_size * y] ) );
+                    }
+                } );
+
+                depth_size = sizeof( uint32_t ) * ( height + 1 );
+                for( const uint32_t size : sizes ){
+                    depth_size += size;
+                }
+            }
+            const size_t color_size = is_mjpg ? color_image.get_size() : has_color ? static_cast<size_t>( width ) * height * 4 : 0;
+
+            // Write Header
+            codec::header header;
+            std::memset( &header, 0, sizeof( codec::header ) );
+            std::memcpy( header.magic, codec::magic, sizeof( codec::magic ) );
+            header.version          = codec::version;
+            header.compression      = static_cast<uint16_t>( compression );
+            header.calibration_id   = codec::get_calibration_id( calibration );
+            header.calibration_type = static_cast<int32_t>( type );
+            header.width            = width;
+            header.height           = height;
+            header.depth_size       = static_cast<uint32_t>( depth_size );
+            header.color_size       = static_cast<uint32_t>( color_size );
+            header.color_format     = static_cast<uint32_t>( is_mjpg ? codec::color_format::mjpg : codec::color_format::bgra );
+            header.timestamp        = static_cast<int64_t>( depth_image.get_device_timestamp().count() );
+
+            frame.resize( sizeof( codec::header ) + depth_size + color_size );
+            uint8_t* dst = frame.data();
+            std::memcpy( dst, &header, sizeof( codec::header ) );
+            dst += sizeof( codec::header );
+
+            // Write Depth
+            if( compression == codec::compression::delta_rle ){
+                // Offsets of Rows
+                uint32_t offset = 0;
+                for( int32_t y = 0; y <= height; y++ ){
+                    std::memcpy( dst + sizeof( uint32_t ) * y, &offset, sizeof( uint32_t ) );
+                    if( y < height ){
+                        offset += sizes[y];
+                    }
+                }
+                dst += sizeof( uint32_t ) * ( height + 1 );
+
+                // Rows
+                const size_t max_row_size = codec::get_max_row_size( width );
+                for( int32_t y = 0; y < height; y++ ){
+                    std::memcpy( dst, &rows[max_row_size * y], sizes[y] );
+                    dst += sizes[y];
+                }
+            }
+            else{
+                for( int32_t y = 0; y < height; y++ ){
+                    std::memcpy( dst, depth_image.get_buffer() + static_cast<size_t>( y ) * depth_image.get_stride_bytes(), row_size );
+                    dst += row_size;
+                }
+            }
+
+            // Write Color
+            if( is_mjpg ){
+                std::memcpy( dst, color_image.get_buffer(), color_size );
+            }
+            else if( has_color ){
+                const size_t color_row_size = static_cast<size_t>( width ) * 4;
+                for( int32_t y = 0; y < height; y++ ){
+                    std::memcpy( dst, color_image.get_buffer() + static_cast<size_t>( y ) * color_image.get_stride_bytes(), color_row_size );
+                    dst += color_row_size;
+                }
+            }
+        }
+    };
+
+    class cloud_decoder
+    {
+    private:
+        // Registered Calibration, and Tables of Rays that are Created on First Use
+        struct entry
+        {
+            uint64_t id;
+            k4a::calibration calibration;
+            std::unique_ptr<k4a::unprojection> unprojections[2];
+        };
+        std::vector<std::unique_ptr<entry>> entries;
+
+        // Decoded Depth Image (Reused in every frame)
+        k4a::image depth_image;
+
+        // Decoded Color of MJPG (Reused in every frame)
+        cv::Mat decoded_color;
+
+    public:
+        // Register Calibration (Frames that are encoded with this calibration can be decoded to point cloud)
+        void register_calibration( const k4a::calibration& calibration )
+        {
+            const uint64_t id = codec::get_calibration_id( calibration );
+            if( find( id ) ){
+                return;
+            }
+
+            std::unique_ptr<entry> value( new entry() );
+            value->id = id;
+            value->calibration = calibration;
+            entries.push_back( std::move( value ) );
+        }
+
+        // Load Calibration from File that was Written by codec::write_calibration(), and Register it (Return ID of calibration)
+        uint64_t load_calibration( const std::string& path )
+        {
+            const k4a::calibration calibration = codec::read_calibration( path );
+            register_calibration( calibration );
+            return codec::get_calibration_id( calibration );
+        }
+
+        // Decode Depth Image of Frame (DEPTH16, it is reused in every frame)
+        const k4a::image& decode_depth( const uint8_t* data, const size_t size )
+        {
+            const codec::header header = codec::read_header( data, size );
+            const int32_t width = header.width;
+            const int32_t height = header.height;
+            if( !depth_image.handle() || depth_image.get_width_pixels() != width || depth_image.get_height_pixels() != height ){
+                depth_image = k4a::image::create( K4A_IMAGE_FORMAT_DEPTH16, width, height, width * static_cast<int32_t>( sizeof( uint16_t ) ) );
+            }
+            depth_image.set_timestamp( std::chrono::microseconds( header.timestamp ) );
+
+            const uint8_t* depth = data + sizeof( codec::header );
+            const size_t row_size = static_cast<size_t>( width ) * sizeof( uint16_t );
+            if( header.compression == static_cast<uint16_t>( codec::compression::raw ) ){
+                if( header.depth_size != row_size * height ){
+                    throw k4a::error( "Failed to decode frame! (invalid size of depth)" );
+                }
+                for( int32_t y = 0; y < height; y++ ){
+                    std::memcpy( depth_image.get_buffer() + static_cast<size_t>( y ) * depth_image.get_stride_bytes(), depth + row_size * y, row_size );
+                }
+                return depth_image;
+            }
+
+            if( header.compression != static_cast<uint16_t>( codec::compression::delta_rle ) ){
+                throw k4a::error( "Failed to decode frame! (unknown compression)" );
+            }
+
+            // Decode Rows of Depth in Parallel
+            const size_t table_size = sizeof( uint32_t ) * ( static_cast<size_t>( height ) + 1 );
+            if( header.depth_size < table_size ){
+                throw k4a::error( "Failed to decode frame! (invalid size of depth)" );
+            }
+            const uint8_t* rows = depth + table_size;
+            const size_t rows_size = header.depth_size - table_size;
+            std::atomic<bool> corrupted( false );
+            cv::parallel_for_( cv::Range( 0, height ), [&]( const cv::Range& range ){
+                for( int32_t y = range.start; y < range.end; y++ ){
+                    uint32_t begin, end;
+                    std::memcpy( &begin, depth + sizeof( uint32_t ) * y, sizeof( uint32_t ) );
+                    std::memcpy( &end, depth + sizeof( uint32_t ) * ( y + 1 ), sizeof( uint32_t ) );
+                    uint16_t* dst = reinterpret_cast<uint16_t*>( depth_image.get_buffer() + static_cast<size_t>( y ) * depth_image.get_stride_bytes() );
+                    if( begin > end || end > rows_size || !codec::decode_row( rows + begin, rows + end, dst, width ) ){
+                        corrupted.store( true, std::memory_order_relaxed );
+                    }
+                }
+            } );
+            if( corrupted ){
+                throw k4a::error( "Failed to decode frame! (depth is corrupted)" );
+            }
+            return depth_image;
+        }
+
+        // Decode Point Cloud and Color of Frame
+        // (xyz is CV_32FC3 (invalid points are NaN), and color is BGRA (empty if color doesn't exist).)
+        // (BGRA color is shared with frame without copy, and MJPG color is decoded to buffer that is reused in every frame.)
+        void decode( const uint8_t* data, const size_t size, cv::Mat& xyz, cv::Mat& color )
+        {
+            const codec::header header = codec::read_header( data, size );
+            entry* value = find( header.calibration_id );
+            if( !value ){
+                throw k4a::error( "Failed to decode frame! (calibration is not registered)" );
+            }
+
+            // Reconstruct Point Cloud from Depth with Table of Rays
+            const size_t type = ( header.calibration_type == static_cast<int32_t>( K4A_CALIBRATION_TYPE_COLOR ) ) ? 1 : 0;
+            std::unique_ptr<k4a::unprojection>& unprojection = value->unprojections[type];
+            if( !unprojection ){
+                unprojection.reset( new k4a::unprojection( value->calibration, type ? K4A_CALIBRATION_TYPE_COLOR : K4A_CALIBRATION_TYPE_DEPTH ) );
+            }
+            unprojection->compute( decode_depth( data, size ), xyz, true );
+
+            // Color
+            if( header.color_size == 0 ){
+                color.release();
+                return;
+            }
+            uint8_t* color_data = const_cast<uint8_t*>( data + sizeof( codec::header ) + header.depth_size );
+            if( header.color_format == static_cast<uint32_t>( codec::color_format::mjpg ) ){
+                // NOTE: compressed buffer is wrapped without copy, because cv::imdecode doesn't modify it.
+                const cv::Mat buffer( 1, static_cast<int32_t>( header.color_size ), CV_8UC1, color_data );
+                const cv::Mat bgr = cv::imdecode( buffer, cv::IMREAD_COLOR );
+                if( bgr.empty() || bgr.cols != header.width || bgr.rows != header.height ){
+                    throw k4a::error( "Failed to decode frame! (color is corrupted)" );
+                }
+                cv::cvtColor( bgr, decoded_color, cv::COLOR_BGR2BGRA );
+                color = decoded_color;
+                return;
+            }
+            if( header.color_format != static_cast<uint32_t>( codec::color_format::bgra ) ){
+                throw k4a::error( "Failed to decode frame! (unknown format of color)" );
+            }
+            if( header.color_size != static_cast<uint64_t>( header.width ) * header.height * 4 ){
+                throw k4a::error( "Failed to decode frame! (invalid size of color)" );
+            }
+            color = cv::Mat( header.height, header.width, CV_8UC4, color_data );
+        }
+
+    private:
+        entry* find( const uint64_t id ) const
+        {
+            for( const std::unique_ptr<entry>& value : entries ){
+                if( value->id == id ){
+                    return value.get();
+                }
+            }
+            return nullptr;
+        }
+    };
+}
+
+#endif // __CODEC__
@@ -2,10 +2,16 @@
 #include "util.h"
 
 #include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
 
 // Constructor
 kinect::kinect( const uint32_t index )
-    : device_index( index )
+    : cpu_reprojection( false ),
+      device_index( index ),
+      downsample( false ),
+      save_count( 0 )
 {
     // Initialize
     initialize();
@@ -30,29 +36,29 @@ void kinect::initialize()
 // Initialize Sensor
 inline void kinect::initialize_sensor()
 {
-    // Get Connected Devices
-    const int32_t device_count = k4a::device::get_installed_count();
-    if( device_count == 0 ){
-        throw k4a::error( "Failed to found device!" );
-    }
-
-    // Open Default Device
-    device = k4a::device::open( device_index );
-
-    // Start Cameras with Configuration
+    // Configuration
     device_configuration = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
     device_configuration.color_format             = k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_BGRA32;
     device_configuration.color_resolution         = k4a_color_resolution_t::K4A_COLOR_RESOLUTION_720P;
     device_configuration.depth_mode               = k4a_depth_mode_t::K4A_DEPTH_MODE_NFOV_UNBINNED;
     device_configuration.synchronized_images_only = true;
     device_configuration.wired_sync_mode          = k4a_wired_sync_mode_t::K4A_WIRED_SYNC_MODE_STANDALONE;
-    device.start_cameras( &device_configuration );
+
+    // Open Device and Start Cameras
+    // (Synthetic source is used instead of device if K4A_SOURCE=synthetic is set.)
+    source = k4a::open_source( device_index, device_configuration );
 
     // Get Calibration
-    calibration = device.get_calibration( device_configuration.depth_mode, device_configuration.color_resolution );
+    calibration = source->get_calibration();
 
     // Create Transformation
     transformation = k4a::transformation( calibration );
+
+    // Create Pool of Transformed Images
+    pool.reset( calibration );
+
+    // Create Table of Rays for Point Cloud in Color Camera (Computed once per calibration)
+    unprojection.reset( calibration, K4A_CALIBRATION_TYPE_COLOR );
 }
 
 // Initialize Viewer
@@ -72,14 +78,17 @@ inline void kinect::initialize_viewer()
 // Finalize
 void kinect::finalize()
 {
+    // Close Writer (Wait until all point clouds are written)
+    if( writer ){
+        writer->close();
+        std::cout << "saved " << writer->get_written() << " point clouds (failed " << writer->get_failed() << ")" << std::endl;
+    }
+
     // Destroy Transformation
     transformation.destroy();
 
-    // Stop Cameras
-    device.stop_cameras();
-
-    // Close Device
-    device.close();
+    // Stop Cameras and Close Device
+    source->stop();
 
     // Close Window
     cv::destroyAllWindows();
@@ -90,6 +99,59 @@ void kinect::finalize()
     #endif
 }
 
+// Configure Reprojection
+void kinect::configure_reprojection( const bool cpu )
+{
+    // Create Maps of Reprojection (Computed once per calibration)
+    if( cpu ){
+        reprojection.reset( calibration );
+    }
+
+    cpu_reprojection = cpu;
+}
+
+// Configure Point Cloud
+void kinect::configure_point_cloud( const cv::Rect& roi, const int32_t stride, const cv::Vec3f& crop_min, const cv::Vec3f& crop_max )
+{
+    // Set Region of Point Cloud (Pixels outside of ROI or between strides are not unprojected)
+    unprojection.set_region( roi, stride );
+
+    // Set Crop Box of Point Cloud (Points outside of box are NaN, and they are not uploaded to viewer)
+    if( crop_min[0] <= crop_max[0] && crop_min[1] <= crop_max[1] && crop_min[2] <= crop_max[2] ){
+        unprojection.set_crop_box( crop_min, crop_max );
+    }
+    else{
+        unprojection.clear_crop_box();
+    }
+}
+
+// Configure Voxel Grid
+void kinect::configure_voxel_grid( const float leaf_size, const k4a::voxel_grid::policy policy )
+{
+    downsample = ( leaf_size > 0.0f );
+    if( downsample ){
+        voxel_grid.reset( leaf_size, policy );
+    }
+}
+
+// Configure Writer
+void kinect::configure_writer( const std::string& format, const bool skip_invalid )
+{
+    if( format != "ply" && format != "pcd" && format != "k4dc" ){
+        throw k4a::error( "Failed to configure writer! (format must be ply, pcd, or k4dc)" );
+    }
+
+    // Create Writer (Files are written on background thread)
+    extension = format;
+    // (k4dc is written as encoded frame, so format of point cloud is not used.)
+    writer.reset( new k4a::point_cloud_writer( ( format == "pcd" ) ? k4a::point_cloud_writer::format::pcd : k4a::point_cloud_writer::format::ply, skip_invalid ) );
+
+    // Write Calibration once next to Frames of k4dc (calibration_<id>.bin, it is loaded with k4a::cloud_decoder::load_calibration())
+    if( format == "k4dc" ){
+        k4a::codec::write_calibration( k4a::codec::get_calibration_file( calibration ), calibration );
+    }
+}
+
 // Run
 void kinect::run()
 {
@@ -146,7 +208,7 @@ inline void kinect::update_frame()
 {
     // Get Capture Frame
     constexpr std::chrono::milliseconds time_out( K4A_WAIT_INFINITE );
-    const bool result = device.get_capture( &capture, time_out );
+    const bool result = source->get_capture( &capture, time_out );
     if( !result ){
         this->~kinect();
     }
@@ -174,7 +236,13 @@ inline void kinect::update_transformation()
     }
 
     // Transform Depth Image to Color Camera
-    transformed_depth_image = transformation.depth_image_to_color_camera( depth_image );
+    transformed_depth_image = pool.get_transformed_depth_image();
+    if( cpu_reprojection ){
+        reprojection.depth_image_to_color_camera( depth_image, &transformed_depth_image );
+    }
+    else{
+        transformation.depth_image_to_color_camera( depth_image, &transformed_depth_image );
+    }
 }
 
 // Update Point Cloud
@@ -184,8 +252,57 @@ inline void kinect::update_point_cloud()
         return;
     }
 
-    // Transform Depth Image to Point Cloud
-    xyz_image = transformation.depth_image_to_point_cloud( transformed_depth_image, K4A_CALIBRATION_TYPE_COLOR );
+    // Transform Depth Image to Point Cloud with Table of Rays
+    // (Point cloud is computed to cv::Mat (CV_32FC3) directly, Invalid Points are NaN)
+    // (Only pixels in region are unprojected, so size of point cloud is unprojection.get_size())
+    unprojection.compute( transformed_depth_image, xyz, true );
+
+    // Save Point Cloud
+    save_point_cloud();
+}
+
+// Save Point Cloud
+inline void kinect::save_point_cloud()
+{
+    if( !writer ){
+        return;
+    }
+
+    std::ostringstream path;
+    path << "cloud_" << std::setw( 6 ) << std::setfill( '0' ) << save_count++ << "." << extension;
+
+    // Encode Depth and Color with ID of Calibration (Point cloud is reconstructed on decode with k4a::cloud_decoder and calibration file)
+    // (Whole organized point cloud in color camera is encoded, region of point cloud is not applied.)
+    if( extension == "k4dc" ){
+        std::vector<uint8_t> data = writer->get_data();
+        encoder.encode( calibration, K4A_CALIBRATION_TYPE_COLOR, transformed_depth_image, color_image, data );
+        writer->push( path.str(), std::move( data ) );
+        return;
+    }
+
+    // Compute Point Cloud to Image of Writer (int16x3, it is recycled after written)
+    const cv::Size size = unprojection.get_size();
+    k4a::image xyz_image = writer->get_xyz_image( size.width, size.height );
+    unprojection.compute( transformed_depth_image, xyz_image );
+
+    // Color of Points
+    // (Color image of capture is written as is if point cloud is whole image, otherwise color is sampled to image of writer.)
+    k4a::image point_color_image;
+    if( color_image.handle() ){
+        if( color_image.get_width_pixels() == size.width && color_image.get_height_pixels() == size.height ){
+            point_color_image = color_image;
+        }
+        else{
+            point_color_image = writer->get_color_image( size.width, size.height );
+            cv::Mat sampled;
+            unprojection.sample( k4a::get_mat( color_image, false ), sampled );
+            cv::Mat point_color( size, CV_8UC4, point_color_image.get_buffer(), static_cast<size_t>( point_color_image.get_stride_bytes() ) );
+            sampled.copyTo( point_color );
+        }
+    }
+
+    // Push Point Cloud to Writer
+    writer->push( path.str(), xyz_image, point_color_image );
 }
 
 // Draw
@@ -211,8 +328,11 @@ inline void kinect::draw_color()
         return;
     }
 
-    // Get cv::Mat from k4a::image
-    color = k4a::get_mat( color_image );
+    // Get cv::Mat from k4a::image (Shared without Copy)
+    color = k4a::get_mat( color_image, false );
+
+    // Sample Color of Points in the Same Region as Point Cloud
+    unprojection.sample( color, cloud_color );
 
     // Release Color Image Handle
     color_image.reset();
@@ -236,8 +356,8 @@ inline void kinect::draw_transformation()
         return;
     }
 
-    // Get cv::Mat from k4a::image
-    transformed_depth = k4a::get_mat( transformed_depth_image );
+    // Get cv::Mat from k4a::image (Shared without Copy)
+    transformed_depth = k4a::get_mat( transformed_depth_image, false );
 
     // Release Transformed Image Handle
     transformed_depth_image.reset();
@@ -246,15 +366,18 @@ inline void kinect::draw_transformation()
 // Draw Point Cloud
 inline void kinect::draw_point_cloud()
 {
-    if( !xyz_image.handle() ){
+    if( xyz.empty() || cloud_color.empty() ){
         return;
     }
 
-    // Get cv::Mat from k4a::image
-    xyz = k4a::get_mat( xyz_image );
+    if( !downsample ){
+        filtered_xyz = xyz;
+        filtered_color = cloud_color;
+        return;
+    }
 
-    // Release Point Cloud Image Handle
-    xyz_image.reset();
+    // Downsample Point Cloud with Voxel Grid (Hash tables are reused in every frame)
+    voxel_grid.filter( xyz, cloud_color, filtered_xyz, filtered_color );
 }
 
 // Show
@@ -300,13 +423,13 @@ inline void kinect::show_transformation()
 // Show Point Cloud
 inline void kinect::show_point_cloud()
 {
-    if( xyz.empty() || color.empty() ){
+    if( filtered_xyz.empty() || filtered_color.empty() ){
         return;
     }
 
     #ifdef HAVE_OPENCV_VIZ
     // Create Point Cloud Widget
-    cv::viz::WCloud cloud = cv::viz::WCloud( xyz, color );
+    cv::viz::WCloud cloud = cv::viz::WCloud( filtered_xyz, filtered_color );
 
     // Show Widget
     viewer.showWidget( "cloud", cloud );
@@ -7,14 +7,25 @@
 #include <opencv2/viz.hpp>
 #endif
 
+#include "pool.h"
+#include "source.h"
+#include "unprojection.h"
+#include "reprojection.h"
+#include "voxel.h"
+#include "writer.h"
+#include "codec.h"
+
 class kinect
 {
 private:
     // Kinect
-    k4a::device device;
+    std::unique_ptr<k4a::capture_source> source;
     k4a::capture capture;
     k4a::calibration calibration;
     k4a::transformation transformation;
+    k4a::reprojection reprojection;
+    bool cpu_reprojection;
+    k4a::frame_pool pool;
     k4a_device_configuration_t device_configuration;
     uint32_t device_index;
 
@@ -30,8 +41,21 @@ private:
     cv::Mat transformed_depth;
 
     // Point Cloud
-    k4a::image xyz_image;
+    k4a::unprojection unprojection;
     cv::Mat xyz;
+    cv::Mat cloud_color;
+
+    // Voxel Grid
+    k4a::voxel_grid voxel_grid;
+    bool downsample;
+    cv::Mat filtered_xyz;
+    cv::Mat filtered_color;
+
+    // Writer
+    std::unique_ptr<k4a::point_cloud_writer> writer;
+    k4a::cloud_encoder encoder;
+    std::string extension;
+    uint64_t save_count;
 
     // Viewer
     #ifdef HAVE_OPENCV_VIZ
@@ -45,6 +69,18 @@ public:
     // Destructor
     ~kinect();
 
+    // Configure Reprojection (Transform depth image to color camera on CPU with cached maps instead of SDK)
+    void configure_reprojection( const bool cpu );
+
+    // Configure Point Cloud (ROI of color image, stride of pixels, and crop box (mm) that is ignored if min > max)
+    void configure_point_cloud( const cv::Rect& roi, const int32_t stride, const cv::Vec3f& crop_min, const cv::Vec3f& crop_max );
+
+    // Configure Voxel Grid (Leaf size (mm) that is disabled if it is 0, and policy to reduce points in voxel)
+    void configure_voxel_grid( const float leaf_size, const k4a::voxel_grid::policy policy );
+
+    // Configure Writer (Save point cloud of every frame to file of format "ply", "pcd", or "k4dc" (encoded depth and color), and skip invalid points)
+    void configure_writer( const std::string& format, const bool skip_invalid );
+
     // Run
     void run();
 
@@ -85,6 +121,9 @@ private:
     // Update Point Cloud
     void update_point_cloud();
 
+    // Save Point Cloud
+    void save_point_cloud();
+
     // Draw Color
     void draw_color();
 
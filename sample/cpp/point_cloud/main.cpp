@@ -1,12 +1,101 @@
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <vector>
 
 #include "kinect.hpp"
 
+// Parse Comma Separated Values (e.g. "320,180,640,360")
+std::vector<float> parse_values( const std::string& option, const size_t count )
+{
+    std::vector<float> values;
+    std::stringstream stream( option );
+    std::string value;
+    while( std::getline( stream, value, ',' ) ){
+        values.push_back( std::stof( value ) );
+    }
+    if( values.size() != count ){
+        throw k4a::error( "Failed to parse option! (" + option + ")" );
+    }
+    return values;
+}
+
+// Show Usage (Return error code of invalid options)
+int usage( const char* name )
+{
+    std::cout << "usage: " << name << " [--cpu] [--roi x,y,width,height] [--stride N] [--crop min_x,min_y,min_z,max_x,max_y,max_z] [--voxel leaf_size] [--voxel-first] [--save ply|pcd|k4dc] [--keep-invalid]" << std::endl;
+    return -1;
+}
+
 int main( int argc, char* argv[] )
 {
+    // Parse Options
+    // point_cloud [--cpu] [--roi x,y,width,height] [--stride N] [--crop min_x,min_y,min_z,max_x,max_y,max_z] [--voxel leaf_size] [--voxel-first] [--save ply|pcd|k4dc] [--keep-invalid]
+    // (--cpu transforms depth image to color camera with reprojection on CPU instead of SDK.)
+    // (--roi, --stride, and --crop reduce point cloud before unprojection. ROI is in color image, and crop box is in mm.)
+    // (--voxel downsamples point cloud with voxel grid of leaf size (mm), --voxel-first keeps first point in voxel instead of centroid.)
+    // (--save writes point cloud of every frame to binary file (cloud_000000.ply), --keep-invalid writes invalid points as (0,0,0).)
+    // (k4dc is compressed depth and color with ID of calibration, point cloud is reconstructed on decode with calibration_<id>.bin.)
+    cv::Rect roi;
+    int32_t stride = 1;
+    // (Crop box is empty (min > max) until --crop is given, so cropping is disabled by default.)
+    cv::Vec3f crop_min( 1.0f, 1.0f, 1.0f );
+    cv::Vec3f crop_max( -1.0f, -1.0f, -1.0f );
+    float leaf_size = 0.0f;
+    k4a::voxel_grid::policy policy = k4a::voxel_grid::policy::centroid;
+    std::string save_format;
+    bool skip_invalid = true;
+    bool cpu = false;
+    try{
+        for( int32_t i = 1; i < argc; i++ ){
+            const std::string option = argv[i];
+            if( option == "--cpu" ){
+                cpu = true;
+            }
+            else if( option == "--roi" && i + 1 < argc ){
+                const std::vector<float> values = parse_values( argv[++i], 4 );
+                roi = cv::Rect( static_cast<int32_t>( values[0] ), static_cast<int32_t>( values[1] ), static_cast<int32_t>( values[2] ), static_cast<int32_t>( values[3] ) );
+            }
+            else if( option == "--stride" && i + 1 < argc ){
+                stride = std::stoi( argv[++i] );
+            }
+            else if( option == "--crop" && i + 1 < argc ){
+                const std::vector<float> values = parse_values( argv[++i], 6 );
+                crop_min = cv::Vec3f( values[0], values[1], values[2] );
+                crop_max = cv::Vec3f( values[3], values[4], values[5] );
+            }
+            else if( option == "--voxel" && i + 1 < argc ){
+                leaf_size = std::stof( argv[++i] );
+            }
+            else if( option == "--voxel-first" ){
+                policy = k4a::voxel_grid::policy::first;
+            }
+            else if( option == "--save" && i + 1 < argc ){
+                save_format = argv[++i];
+            }
+            else if( option == "--keep-invalid" ){
+                skip_invalid = false;
+            }
+            else{
+                // Unknown Option, or Option without Value
+                return usage( argv[0] );
+            }
+        }
+    }
+    catch( const std::exception& ){
+        // Value of Option is not Number (std::invalid_argument), Out of Range (std::out_of_range), or Wrong Number of Values (k4a::error)
+        return usage( argv[0] );
+    }
+
     try{
         kinect kinect;
+        kinect.configure_reprojection( cpu );
+        kinect.configure_point_cloud( roi, stride, crop_min, crop_max );
+        kinect.configure_voxel_grid( leaf_size, policy );
+        if( !save_format.empty() ){
+            kinect.configure_writer( save_format, skip_invalid );
+        }
+
         kinect.run();
     }
     catch( const k4a::error& error ){
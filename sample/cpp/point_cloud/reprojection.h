@@ -0,0 +1,426 @@
+/*
+ This is utility to that provides multi-threaded reprojection of depth image to color camera on CPU.
+ Rays of depth pixels and extrinsics/intrinsics of color camera are cached per calibration,
+ and depth image is reprojected in parallel on thread pool of OpenCV (cv::parallel_for_).
+
+ k4a::reprojection reprojection( calibration );
+ reprojection.depth_image_to_color_camera( depth_image, &transformed_depth_image ); // same as k4a::transformation::depth_image_to_color_camera()
+
+ It works in two phases.
+ 1. Rows of depth image are split into tiles, and each depth pixel is projected to color camera.
+ 2. Rows of color image are split into bands, and quads of neighboring depth pixels are rasterized as two triangles with z-buffer (nearest surface is kept).
+    Depth in triangle is interpolated with barycentric coordinates as same as SDK.
+ Each band is written by only one thread, so no synchronization is needed in z-buffer.
+
+ Copyright (c) 2019 Tsukasa Sugiura <t.sugiura0204@gmail.com>
+ Licensed under the MIT license.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef __REPROJECTION__
+#define __REPROJECTION__
+
+#include <k4a/k4a.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "unprojection.h"
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+namespace k4a
+{
+    class reprojection
+    {
+    private:
+        // Intrinsics of Color Camera
+        struct intrinsics
+        {
+            float cx, cy, fx, fy;
+            float k1, k2, k3, k4, k5, k6;
+            float codx, cody, p1, p2;
+            float max_radius_squared;
+            bool rational;
+        };
+
+        // Depth Camera
+        k4a::unprojection unprojection;
+        int32_t depth_width;
+        int32_t depth_height;
+
+        // Color Camera
+        int32_t color_width;
+        int32_t color_height;
+        float rotation[9];
+        float translation[3];
+        intrinsics color_intrinsics;
+        float offset_u;
+        float offset_v;
+
+        // Projected Depth Pixels (Reused between frames)
+        std::vector<float> us;
+        std::vector<float> vs;
+        std::vector<uint16_t> zs;
+        std::vector<float> row_min_v;
+        std::vector<float> row_max_v;
+
+        // Threshold of Depth Discontinuity between Neighboring Pixels (Ratio to depth)
+        // (Quad that crosses discontinuity is not filled, so foreground doesn't spread to background.)
+        static constexpr float discontinuity = 0.05f;
+
+        // Max Size of Quad (Pixels)
+        static constexpr float max_quad_size = 8.0f;
+
+    public:
+        reprojection()
+            : depth_width( 0 ),
+              depth_height( 0 ),
+              color_width( 0 ),
+              color_height( 0 ),
+              offset_u( 0.0f ),
+              offset_v( 0.0f )
+        {
+        }
+
+        reprojection( const k4a::calibration& calibration )
+            : reprojection()
+        {
+            reset( calibration );
+        }
+
+        // Reset Cache with Calibration
+        void reset( const k4a::calibration& calibration )
+        {
+            // Rays of Depth Pixels
+            unprojection.reset( calibration, K4A_CALIBRATION_TYPE_DEPTH );
+            depth_width  = calibration.depth_camera_calibration.resolution_width;
+            depth_height = calibration.depth_camera_calibration.resolution_height;
+
+            // Extrinsics from Depth Camera to Color Camera
+            const k4a_calibration_extrinsics_t& extrinsics = calibration.extrinsics[K4A_CALIBRATION_TYPE_DEPTH][K4A_CALIBRATION_TYPE_COLOR];
+            std::copy( extrinsics.rotation, extrinsics.rotation + 9, rotation );
+            std::copy( extrinsics.translation, extrinsics.translation + 3, translation );
+
+            // Intrinsics of Color Camera
+            const k4a_calibration_camera_t& camera = calibration.color_camera_calibration;
+            color_width  = camera.resolution_width;
+            color_height = camera.resolution_height;
+            const k4a_calibration_intrinsic_parameters_t& parameters = camera.intrinsics.parameters;
+            color_intrinsics.cx   = parameters.param.cx;
+            color_intrinsics.cy   = parameters.param.cy;
+            color_intrinsics.fx   = parameters.param.fx;
+            color_intrinsics.fy   = parameters.param.fy;
+            color_intrinsics.k1   = parameters.param.k1;
+            color_intrinsics.k2   = parameters.param.k2;
+            color_intrinsics.k3   = parameters.param.k3;
+            color_intrinsics.k4   = parameters.param.k4;
+            color_intrinsics.k5   = parameters.param.k5;
+            color_intrinsics.k6   = parameters.param.k6;
+            color_intrinsics.codx = parameters.param.codx;
+            color_intrinsics.cody = parameters.param.cody;
+            color_intrinsics.p1   = parameters.param.p1;
+            color_intrinsics.p2   = parameters.param.p2;
+            color_intrinsics.rational = ( camera.intrinsics.type == K4A_CALIBRATION_LENS_DISTORTION_MODEL_RATIONAL_6KT );
+            const float metric_radius = ( parameters.param.metric_radius > 0.0f ) ? parameters.param.metric_radius : camera.metric_radius;
+            color_intrinsics.max_radius_squared = ( metric_radius > 0.0f ) ? metric_radius * metric_radius : std::numeric_limits<float>::max();
+
+            // Align Projection to SDK
+            align( calibration );
+
+            // Allocate Buffers
+            const size_t size = static_cast<size_t>( depth_width ) * depth_height;
+            us.resize( size );
+            vs.resize( size );
+            zs.resize( size );
+            row_min_v.resize( static_cast<size_t>( depth_height ) );
+            row_max_v.resize( static_cast<size_t>( depth_height ) );
+        }
+
+        // Transform Depth Image to Color Camera
+        // (transformed_depth_image must be K4A_IMAGE_FORMAT_DEPTH16 image of color camera resolution (e.g. k4a::frame_pool::get_transformed_depth_image()).)
+        void depth_image_to_color_camera( const k4a::image& depth_image, k4a::image* transformed_depth_image )
+        {
+            if( depth_image.get_width_pixels() != depth_width || depth_image.get_height_pixels() != depth_height ){
+                throw k4a::error( "Failed to reproject! (size of depth image doesn't match calibration)" );
+            }
+            if( transformed_depth_image == nullptr || transformed_depth_image->get_width_pixels() != color_width || transformed_depth_image->get_height_pixels() != color_height ){
+                throw k4a::error( "Failed to reproject! (size of transformed depth image doesn't match calibration)" );
+            }
+
+            // Project Depth Pixels to Color Camera (Tiles of depth rows)
+            const uint8_t* depth_buffer = depth_image.get_buffer();
+            const size_t depth_stride = static_cast<size_t>( depth_image.get_stride_bytes() );
+            cv::parallel_for_( cv::Range( 0, depth_height ), [&]( const cv::Range& range ){
+                for( int32_t y = range.start; y < range.end; y++ ){
+                    project_row( reinterpret_cast<const uint16_t*>( depth_buffer + y * depth_stride ), y );
+                }
+            } );
+
+            // Splat Quads to Color Image with Z-Buffer (Bands of color rows)
+            uint8_t* color_buffer = transformed_depth_image->get_buffer();
+            const size_t color_stride = static_cast<size_t>( transformed_depth_image->get_stride_bytes() );
+            constexpr int32_t band_height = 16;
+            const int32_t bands = ( color_height + band_height - 1 ) / band_height;
+            cv::parallel_for_( cv::Range( 0, bands ), [&]( const cv::Range& range ){
+                for( int32_t band = range.start; band < range.end; band++ ){
+                    const int32_t begin = band * band_height;
+                    const int32_t end = std::min( begin + band_height, color_height );
+                    for( int32_t v = begin; v < end; v++ ){
+                        std::memset( color_buffer + v * color_stride, 0, static_cast<size_t>( color_width ) * sizeof( uint16_t ) );
+                    }
+                    splat_band( color_buffer, color_stride, begin, end );
+                }
+            } );
+        }
+
+    private:
+        // Project Distorted Point (x/z, y/z) to Color Image (Same model as SDK)
+        bool project( const float x, const float y, float& u, float& v ) const
+        {
+            const intrinsics& p = color_intrinsics;
+            const float xp = x - p.codx;
+            const float yp = y - p.cody;
+            const float xp2 = xp * xp;
+            const float yp2 = yp * yp;
+            const float xyp = xp * yp;
+            const float rs = xp2 + yp2;
+            if( rs > p.max_radius_squared ){
+                return false;
+            }
+
+            const float rss = rs * rs;
+            const float rsc = rss * rs;
+            const float a = 1.0f + p.k1 * rs + p.k2 * rss + p.k3 * rsc;
+            const float b = 1.0f + p.k4 * rs + p.k5 * rss + p.k6 * rsc;
+            const float d = ( b != 0.0f ) ? a / b : a;
+
+            float xp_d = xp * d;
+            float yp_d = yp * d;
+            const float rs_2xp2 = rs + 2.0f * xp2;
+            const float rs_2yp2 = rs + 2.0f * yp2;
+            if( p.rational ){
+                xp_d += rs_2xp2 * p.p2 + xyp * p.p1;
+                yp_d += rs_2yp2 * p.p1 + xyp * p.p2;
+            }
+            else{
+                xp_d += rs_2xp2 * p.p2 + 2.0f * xyp * p.p1;
+                yp_d += rs_2yp2 * p.p1 + 2.0f * xyp * p.p2;
+            }
+
+            u = ( xp_d + p.codx ) * p.fx + p.cx + offset_u;
+            v = ( yp_d + p.cody ) * p.fy + p.cy + offset_v;
+            return true;
+        }
+
+        // Align Projection to SDK
+        // Convention of pixel coordinates (e.g. center of top-left pixel) is measured from k4a::calibration::convert_2d_to_3d(),
+        // and calibration is rejected if projection doesn't match SDK.
+        void align( const k4a::calibration& calibration )
+        {
+            offset_u = offset_v = 0.0f;
+
+            std::vector<cv::Point2f> errors;
+            constexpr int32_t grid = 16;
+            for( int32_t j = 1; j < grid; j++ ){
+                for( int32_t i = 1; i < grid; i++ ){
+                    k4a_float2_t point2d;
+                    point2d.xy.x = static_cast<float>( color_width * i / grid );
+                    point2d.xy.y = static_cast<float>( color_height * j / grid );
+                    k4a_float3_t point3d;
+                    if( !calibration.convert_2d_to_3d( point2d, 1000.0f, K4A_CALIBRATION_TYPE_COLOR, K4A_CALIBRATION_TYPE_COLOR, &point3d ) ){
+                        continue;
+                    }
+
+                    float u, v;
+                    if( project( point3d.xyz.x / point3d.xyz.z, point3d.xyz.y / point3d.xyz.z, u, v ) ){
+                        errors.push_back( cv::Point2f( point2d.xy.x - u, point2d.xy.y - v ) );
+                    }
+                }
+            }
+            if( errors.empty() ){
+                throw k4a::error( "Failed to create reprojection! (color camera can't be projected)" );
+            }
+
+            cv::Point2f offset( 0.0f, 0.0f );
+            for( const cv::Point2f& error : errors ){
+                offset.x += error.x / static_cast<float>( errors.size() );
+                offset.y += error.y / static_cast<float>( errors.size() );
+            }
+
+            constexpr float tolerance = 0.05f; // Pixels
+            for( const cv::Point2f& error : errors ){
+                if( std::abs( error.x - offset.x ) > tolerance || std::abs( error.y - offset.y ) > tolerance ){
+                    throw k4a::error( "Failed to create reprojection! (lens distortion model of color camera is not supported)" );
+                }
+            }
+
+            offset_u = offset.x;
+            offset_v = offset.y;
+        }
+
+        // Project Row of Depth Image to Color Camera
+        void project_row( const uint16_t* depth, const int32_t y )
+        {
+            const float* rays = unprojection.get_rays().data() + static_cast<size_t>( y ) * depth_width * 3;
+            const size_t offset = static_cast<size_t>( y ) * depth_width;
+            const float* r = rotation;
+            const float* t = translation;
+
+            float min_v = std::numeric_limits<float>::max();
+            float max_v = std::numeric_limits<float>::lowest();
+            for( int32_t x = 0; x < depth_width; x++ ){
+                const size_t index = offset + x;
+                zs[index] = 0;
+
+                const float d = static_cast<float>( depth[x] );
+                const float* ray = rays + x * 3;
+                if( d == 0.0f || std::isnan( ray[2] ) ){
+                    continue;
+                }
+
+                // Point in Depth Camera, and Point in Color Camera
+                const float px = ray[0] * d;
+                const float py = ray[1] * d;
+                const float pz = d;
+                const float qx = r[0] * px + r[1] * py + r[2] * pz + t[0];
+                const float qy = r[3] * px + r[4] * py + r[5] * pz + t[1];
+                const float qz = r[6] * px + r[7] * py + r[8] * pz + t[2];
+                if( qz <= 0.0f ){
+                    continue;
+                }
+
+                float u, v;
+                if( !project( qx / qz, qy / qz, u, v ) ){
+                    continue;
+                }
+
+                us[index] = u;
+                vs[index] = v;
+                zs[index] = static_cast<uint16_t>( std::min( qz + 0.5f, 65535.0f ) );
+                min_v = std::min( min_v, v );
+                max_v = std::max( max_v, v );
+            }
+
+            row_min_v[y] = min_v;
+            row_max_v[y] = max_v;
+        }
+
+        // Splat Depth Pixels to Band of Color Image [begin, end)
+        void splat_band( uint8_t* color_buffer, const size_t color_stride, const int32_t begin, const int32_t end ) const
+        {
+            for( int32_t y = 0; y < depth_height; y++ ){
+                // Skip Rows that don't reach Band
+                const int32_t next = std::min( y + 1, depth_height - 1 );
+                const float min_v = std::min( row_min_v[y], row_min_v[next] );
+                const float max_v = std::max( row_max_v[y], row_max_v[next] );
+                if( max_v < begin - 1 || min_v > end ){
+                    continue;
+                }
+
+                for( int32_t x = 0; x < depth_width; x++ ){
+                    const size_t i00 = static_cast<size_t>( y ) * depth_width + x;
+                    const uint16_t z00 = zs[i00];
+                    if( z00 == 0 ){
+                        continue;
+                    }
+
+                    // Fill Quad of Neighboring Pixels as Two Triangles
+                    if( x + 1 < depth_width && y + 1 < depth_height ){
+                        const size_t i01 = i00 + 1;
+                        const size_t i10 = i00 + depth_width;
+                        const size_t i11 = i10 + 1;
+                        const uint16_t z01 = zs[i01];
+                        const uint16_t z10 = zs[i10];
+                        const uint16_t z11 = zs[i11];
+                        if( z01 != 0 && z10 != 0 && z11 != 0 ){
+                            const float min_z = std::min( std::min( z00, z01 ), std::min( z10, z11 ) );
+                            const float max_z = std::max( std::max( z00, z01 ), std::max( z10, z11 ) );
+                            const float u0 = std::min( std::min( us[i00], us[i01] ), std::min( us[i10], us[i11] ) );
+                            const float u1 = std::max( std::max( us[i00], us[i01] ), std::max( us[i10], us[i11] ) );
+                            const float v0 = std::min( std::min( vs[i00], vs[i01] ), std::min( vs[i10], vs[i11] ) );
+                            const float v1 = std::max( std::max( vs[i00], vs[i01] ), std::max( vs[i10], vs[i11] ) );
+                            if( max_z - min_z <= min_z * discontinuity && u1 - u0 <= max_quad_size && v1 - v0 <= max_quad_size ){
+                                fill_triangle( color_buffer, color_stride, begin, end, i00, i01, i11 );
+                                fill_triangle( color_buffer, color_stride, begin, end, i00, i11, i10 );
+                                continue;
+                            }
+                        }
+                    }
+
+                    // Splat Single Pixel at Edge of Surface
+                    const int32_t u = static_cast<int32_t>( std::floor( us[i00] + 0.5f ) );
+                    const int32_t v = static_cast<int32_t>( std::floor( vs[i00] + 0.5f ) );
+                    if( u >= 0 && u < color_width && v >= begin && v < end ){
+                        write( color_buffer, color_stride, u, v, z00 );
+                    }
+                }
+            }
+        }
+
+        // Fill Pixels in Triangle of Projected Depth Pixels (Clipped to band)
+        // (Pixel is filled if its center is inside triangle or on edge, and depth is interpolated with barycentric coordinates.)
+        void fill_triangle( uint8_t* color_buffer, const size_t color_stride, const int32_t begin, const int32_t end, const size_t a, const size_t b, const size_t c ) const
+        {
+            const float ua = us[a], va = vs[a];
+            const float ub = us[b], vb = vs[b];
+            const float uc = us[c], vc = vs[c];
+            const float area = ( ub - ua ) * ( vc - va ) - ( uc - ua ) * ( vb - va );
+            if( std::abs( area ) < std::numeric_limits<float>::epsilon() ){
+                return;
+            }
+
+            const int32_t u_begin = std::max( static_cast<int32_t>( std::ceil( std::min( std::min( ua, ub ), uc ) ) ), 0 );
+            const int32_t u_end   = std::min( static_cast<int32_t>( std::floor( std::max( std::max( ua, ub ), uc ) ) ) + 1, color_width );
+            const int32_t v_begin = std::max( static_cast<int32_t>( std::ceil( std::min( std::min( va, vb ), vc ) ) ), begin );
+            const int32_t v_end   = std::min( static_cast<int32_t>( std::floor( std::max( std::max( va, vb ), vc ) ) ) + 1, end );
+
+            // Tolerance of Barycentric Coordinates (Pixels on shared edge of two triangles are not missed by rounding error)
+            constexpr float tolerance = -1e-5f;
+            const float inverse_area = 1.0f / area;
+            const float za = zs[a], zb = zs[b], zc = zs[c];
+            for( int32_t v = v_begin; v < v_end; v++ ){
+                for( int32_t u = u_begin; u < u_end; u++ ){
+                    const float wb = ( ( u - ua ) * ( vc - va ) - ( uc - ua ) * ( v - va ) ) * inverse_area;
+                    const float wc = ( ( ub - ua ) * ( v - va ) - ( u - ua ) * ( vb - va ) ) * inverse_area;
+                    const float wa = 1.0f - wb - wc;
+                    if( wa < tolerance || wb < tolerance || wc < tolerance ){
+                        continue;
+                    }
+                    write( color_buffer, color_stride, u, v, static_cast<uint16_t>( za * wa + zb * wb + zc * wc + 0.5f ) );
+                }
+            }
+        }
+
+        // Write Depth to Z-Buffer (Nearest surface is kept)
+        static void write( uint8_t* color_buffer, const size_t color_stride, const int32_t u, const int32_t v, const uint16_t z )
+        {
+            uint16_t& pixel = reinterpret_cast<uint16_t*>( color_buffer + v * color_stride )[u];
+            if( pixel == 0 || z < pixel ){
+                pixel = z;
+            }
+        }
+    };
+}
+
+#endif // __REPROJECTION__
@@ -0,0 +1,456 @@
+/*
+ This is utility to that provides fast generation of point cloud from depth image using precomputed table of rays.
+ The ray (x/z, y/z, 1) of each pixel depends only on calibration, so it is computed once per calibration,
+ and point of each pixel is computed by a single multiply per component (vectorized with AVX2/SSE2 if it is available).
+
+ k4a::unprojection unprojection( calibration, K4A_CALIBRATION_TYPE_COLOR );
+ unprojection.compute( transformed_depth_image, xyz, true );  // cv::Mat (CV_32FC3) directly (invalid points are NaN)
+ unprojection.compute( transformed_depth_image, xyz_image );  // k4a::image (K4A_IMAGE_FORMAT_CUSTOM) same as k4a::transformation::depth_image_to_point_cloud()
+
+ Point cloud can be reduced before unprojection with ROI of image and stride of pixels, and points outside of crop box are invalid.
+ Size of point cloud is get_size(), and image (e.g. color) can be sampled in the same way with sample().
+
+ unprojection.set_region( cv::Rect( 320, 180, 640, 360 ), 2 );                     // ROI, and every 2nd pixel of rows/columns (320x180 points)
+ unprojection.set_crop_box( cv::Vec3f( -500, -500, 300 ), cv::Vec3f( 500, 500, 1500 ) ); // working volume (mm)
+ unprojection.sample( color, cloud_color );                                         // color of points
+
+ Copyright (c) 2019 Tsukasa Sugiura <t.sugiura0204@gmail.com>
+ Licensed under the MIT license.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef __UNPROJECTION__
+#define __UNPROJECTION__
+
+#include <k4a/k4a.hpp>
+#include <opencv2/opencv.hpp>
+
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+#if defined( __x86_64__ ) || defined( __i386__ ) || defined( _M_X64 ) || defined( _M_IX86 )
+#define __UNPROJECTION_X86__
+#include <immintrin.h>
+#if defined( _MSC_VER ) && !defined( __clang__ )
+#define __UNPROJECTION_TARGET__( name )
+#else
+#define __UNPROJECTION_TARGET__( name ) __attribute__(( target( name ) ))
+#endif
+#endif
+
+namespace k4a
+{
+    class unprojection
+    {
+    private:
+        int32_t width;
+        int32_t height;
+
+        // Table of Rays (x/z, y/z, 1) per Pixel (Invalid ray is NaN)
+        std::vector<float> rays;
+
+        // Region of Point Cloud (ROI of image, and stride of pixels)
+        // (If stride is more than 1, rays of sampled pixels are packed into table, so kernels can be used as is.)
+        cv::Rect roi;
+        int32_t stride;
+        std::vector<float> sampled_rays;
+
+        // Crop Box of Point Cloud (mm)
+        bool crop;
+        cv::Vec3f crop_min;
+        cv::Vec3f crop_max;
+
+        // Kernel to Compute Points (float32x3) of Row
+        using kernel_function = void ( * )( const uint16_t*, const float*, float*, const int32_t, const bool );
+        kernel_function kernel;
+
+    public:
+        unprojection()
+            : width( 0 ),
+              height( 0 ),
+              stride( 1 ),
+              crop( false ),
+              kernel( compute_points_scalar )
+        {
+        }
+
+        unprojection( const k4a::calibration& calibration, const k4a_calibration_type_t type )
+            : unprojection()
+        {
+            reset( calibration, type );
+        }
+
+        // Reset Table with Calibration of Camera
+        // (Table is computed in the same way as k4a::transformation, so points are same as k4a::transformation::depth_image_to_point_cloud().)
+        // (Region is reset to whole image, crop box is kept.)
+        void reset( const k4a::calibration& calibration, const k4a_calibration_type_t type )
+        {
+            const k4a_calibration_camera_t& camera = ( type == k4a_calibration_type_t::K4A_CALIBRATION_TYPE_COLOR ) ? calibration.color_camera_calibration : calibration.depth_camera_calibration;
+            width  = camera.resolution_width;
+            height = camera.resolution_height;
+
+            const float nan = std::numeric_limits<float>::quiet_NaN();
+            rays.resize( static_cast<size_t>( width ) * height * 3 );
+            for( int32_t y = 0; y < height; y++ ){
+                for( int32_t x = 0; x < width; x++ ){
+                    float* ray = &rays[( static_cast<size_t>( y ) * width + x ) * 3];
+
+                    // Unproject Pixel at 1 mm
+                    k4a_float2_t point2d;
+                    point2d.xy.x = static_cast<float>( x );
+                    point2d.xy.y = static_cast<float>( y );
+                    k4a_float3_t point3d;
+                    if( calibration.convert_2d_to_3d( point2d, 1.0f, type, type, &point3d ) ){
+                        ray[0] = point3d.xyz.x;
+                        ray[1] = point3d.xyz.y;
+                        ray[2] = 1.0f;
+                    }
+                    else{
+                        ray[0] = ray[1] = ray[2] = nan;
+                    }
+                }
+            }
+            set_region( cv::Rect(), 1 );
+
+            // Select Kernel at Runtime
+            kernel = compute_points_scalar;
+            #ifdef __UNPROJECTION_X86__
+            if( cv::checkHardwareSupport( CV_CPU_AVX2 ) ){
+                kernel = compute_points_avx2;
+            }
+            else if( cv::checkHardwareSupport( CV_CPU_SSE2 ) ){
+                kernel = compute_points_sse2;
+            }
+            #endif
+        }
+
+        // Set Region of Point Cloud (ROI of image, and stride of pixels in rows/columns)
+        // (Empty ROI is whole image, and ROI is clipped to image.)
+        void set_region( const cv::Rect& region, const int32_t step = 1 )
+        {
+            if( step < 1 ){
+                throw k4a::error( "Failed to set region of point cloud! (stride must be positive)" );
+            }
+
+            const cv::Rect image( 0, 0, width, height );
+            roi = ( region.area() > 0 ) ? ( region & image ) : image;
+            if( roi.area() <= 0 && image.area() > 0 ){
+                throw k4a::error( "Failed to set region of point cloud! (ROI is out of image)" );
+            }
+            stride = step;
+
+            // Pack Rays of Sampled Pixels
+            sampled_rays.clear();
+            if( stride > 1 ){
+                const cv::Size size = get_size();
+                sampled_rays.resize( static_cast<size_t>( size.area() ) * 3 );
+                float* sampled = sampled_rays.data();
+                for( int32_t y = 0; y < size.height; y++ ){
+                    const float* ray = &rays[( static_cast<size_t>( roi.y + y * stride ) * width + roi.x ) * 3];
+                    for( int32_t x = 0; x < size.width; x++ ){
+                        const float* r = ray + static_cast<size_t>( x ) * stride * 3;
+                        *sampled++ = r[0];
+                        *sampled++ = r[1];
+                        *sampled++ = r[2];
+                    }
+                }
+            }
+        }
+
+        // Set Crop Box of Point Cloud (Points outside of box [min, max] (mm) are invalid)
+        // (Box that is infinite on all axes doesn't crop any point, so cropping is disabled for it.)
+        void set_crop_box( const cv::Vec3f& min, const cv::Vec3f& max )
+        {
+            const float infinity = std::numeric_limits<float>::infinity();
+            bool infinite = true;
+            for( int32_t i = 0; i < 3; i++ ){
+                infinite &= ( min[i] == -infinity && max[i] == infinity );
+            }
+            crop = !infinite;
+            crop_min = min;
+            crop_max = max;
+        }
+
+        // Clear Crop Box of Point Cloud
+        void clear_crop_box()
+        {
+            crop = false;
+        }
+
+        // Compute Point Cloud to cv::Mat (CV_32FC3)
+        // (If invalid_as_nan is true, invalid points are NaN (it is skipped in cv::viz::WCloud), otherwise they are (0,0,0).)
+        void compute( const k4a::image& depth_image, cv::Mat& xyz, const bool invalid_as_nan = false ) const
+        {
+            check( depth_image );
+
+            const cv::Size size = get_size();
+            xyz.create( size, CV_32FC3 );
+            std::vector<uint16_t> samples( ( stride > 1 ) ? size.width : 0 );
+            for( int32_t y = 0; y < size.height; y++ ){
+                float* points = xyz.ptr<float>( y );
+                kernel( get_depth_row( depth_image, y, samples ), get_ray_row( y ), points, size.width, invalid_as_nan );
+                if( crop ){
+                    crop_points( points, size.width, invalid_as_nan );
+                }
+            }
+        }
+
+        // Compute Point Cloud to k4a::image (K4A_IMAGE_FORMAT_CUSTOM, int16x3)
+        void compute( const k4a::image& depth_image, k4a::image& xyz_image ) const
+        {
+            check( depth_image );
+            const cv::Size size = get_size();
+            if( xyz_image.get_width_pixels() != size.width || xyz_image.get_height_pixels() != size.height ){
+                throw k4a::error( "Failed to compute point cloud! (size of point cloud image doesn't match)" );
+            }
+
+            uint8_t* xyz_buffer = xyz_image.get_buffer();
+            const size_t xyz_stride = static_cast<size_t>( xyz_image.get_stride_bytes() );
+            std::vector<uint16_t> samples( ( stride > 1 ) ? size.width : 0 );
+            for( int32_t y = 0; y < size.height; y++ ){
+                const uint16_t* depth = get_depth_row( depth_image, y, samples );
+                const float* ray = get_ray_row( y );
+                int16_t* points = reinterpret_cast<int16_t*>( xyz_buffer + y * xyz_stride );
+                for( int32_t x = 0; x < size.width; x++ ){
+                    const float z = static_cast<float>( depth[x] );
+                    const float* r = ray + x * 3;
+                    int16_t* point = points + x * 3;
+                    if( z != 0.0f && !std::isnan( r[2] ) ){
+                        point[0] = static_cast<int16_t>( std::floor( r[0] * z + 0.5f ) );
+                        point[1] = static_cast<int16_t>( std::floor( r[1] * z + 0.5f ) );
+                        point[2] = static_cast<int16_t>( depth[x] );
+                        if( !crop || inside( point[0], point[1], point[2] ) ){
+                            continue;
+                        }
+                    }
+                    point[0] = point[1] = point[2] = 0;
+                }
+            }
+        }
+
+        // Sample Image (e.g. Color) in the Same Region as Point Cloud
+        // (Image is shared without copy if region is whole image.)
+        void sample( const cv::Mat& image, cv::Mat& sampled ) const
+        {
+            if( image.cols != width || image.rows != height ){
+                throw k4a::error( "Failed to sample image! (size of image doesn't match calibration)" );
+            }
+
+            if( stride == 1 ){
+                sampled = image( roi );
+                return;
+            }
+
+            const cv::Size size = get_size();
+            const size_t element = image.elemSize();
+            sampled.create( size, image.type() );
+            for( int32_t y = 0; y < size.height; y++ ){
+                const uint8_t* src = image.ptr<uint8_t>( roi.y + y * stride ) + roi.x * element;
+                uint8_t* dst = sampled.ptr<uint8_t>( y );
+                for( int32_t x = 0; x < size.width; x++ ){
+                    std::memcpy( dst + x * element, src + static_cast<size_t>( x ) * stride * element, element );
+                }
+            }
+        }
+
+        int32_t get_width() const
+        {
+            return width;
+        }
+
+        int32_t get_height() const
+        {
+            return height;
+        }
+
+        // Get Size of Point Cloud (Size of ROI divided by stride)
+        cv::Size get_size() const
+        {
+            return cv::Size( ( roi.width + stride - 1 ) / stride, ( roi.height + stride - 1 ) / stride );
+        }
+
+        // Get Table of Rays (x/z, y/z, 1) per Pixel (Invalid ray is NaN)
+        const std::vector<float>& get_rays() const
+        {
+            return rays;
+        }
+
+    private:
+        // Check Size of Depth Image
+        void check( const k4a::image& depth_image ) const
+        {
+            if( depth_image.get_width_pixels() != width || depth_image.get_height_pixels() != height ){
+                throw k4a::error( "Failed to compute point cloud! (size of depth image doesn't match calibration)" );
+            }
+        }
+
+        // Get Depth of Sampled Pixels in Row of Point Cloud
+        const uint16_t* get_depth_row( const k4a::image& depth_image, const int32_t y, std::vector<uint16_t>& samples ) const
+        {
+            const uint8_t* buffer = depth_image.get_buffer() + static_cast<size_t>( roi.y + y * stride ) * depth_image.get_stride_bytes();
+            const uint16_t* depth = reinterpret_cast<const uint16_t*>( buffer ) + roi.x;
+            if( stride == 1 ){
+                return depth;
+            }
+
+            for( size_t x = 0; x < samples.size(); x++ ){
+                samples[x] = depth[x * stride];
+            }
+            return samples.data();
+        }
+
+        // Get Rays of Sampled Pixels in Row of Point Cloud
+        const float* get_ray_row( const int32_t y ) const
+        {
+            if( stride == 1 ){
+                return &rays[( static_cast<size_t>( roi.y + y ) * width + roi.x ) * 3];
+            }
+            return &sampled_rays[static_cast<size_t>( y ) * get_size().width * 3];
+        }
+
+        // Check Point is Inside of Crop Box
+        template<typename type>
+        bool inside( const type x, const type y, const type z ) const
+        {
+            return crop_min[0] <= x && x <= crop_max[0] &&
+                   crop_min[1] <= y && y <= crop_max[1] &&
+                   crop_min[2] <= z && z <= crop_max[2];
+        }
+
+        // Invalidate Points outside of Crop Box
+        // (Invalid point (NaN) is also outside, because comparison with NaN is false.)
+        void crop_points( float* points, const int32_t count, const bool invalid_as_nan ) const
+        {
+            const float invalid = invalid_as_nan ? std::numeric_limits<float>::quiet_NaN() : 0.0f;
+            for( int32_t i = 0; i < count; i++ ){
+                float* point = points + i * 3;
+                if( !inside( point[0], point[1], point[2] ) ){
+                    point[0] = point[1] = point[2] = invalid;
+                }
+            }
+        }
+
+        // Compute Points of Row
+        static void compute_points_scalar( const uint16_t* depth, const float* ray, float* dst, const int32_t count, const bool invalid_as_nan )
+        {
+            const float invalid = invalid_as_nan ? std::numeric_limits<float>::quiet_NaN() : 0.0f;
+            for( int32_t i = 0; i < count; i++ ){
+                const float z = static_cast<float>( depth[i] );
+                const float* r = ray + i * 3;
+                float* point = dst + i * 3;
+                if( z != 0.0f && !std::isnan( r[2] ) ){
+                    point[0] = r[0] * z;
+                    point[1] = r[1] * z;
+                    point[2] = r[2] * z;
+                }
+                else{
+                    point[0] = point[1] = point[2] = invalid;
+                }
+            }
+        }
+
+        #ifdef __UNPROJECTION_X86__
+        // Compute Points of Row (4 points (12 values) per block)
+        // NOTE: Invalid ray is NaN, so it becomes NaN after multiply, and it is cleared to 0 if invalid_as_nan is false.
+        __UNPROJECTION_TARGET__( "sse2" )
+        static void compute_points_sse2( const uint16_t* depth, const float* ray, float* dst, const int32_t count, const bool invalid_as_nan )
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128 nan = _mm_set1_ps( std::numeric_limits<float>::quiet_NaN() );
+            constexpr int32_t block = 4;
+            int32_t i = 0;
+            for( ; i + block <= count; i += block ){
+                const __m128i value = _mm_unpacklo_epi16( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( depth + i ) ), zero );
+                __m128 z = _mm_cvtepi32_ps( value );
+                if( invalid_as_nan ){
+                    const __m128 mask = _mm_cmpeq_ps( z, _mm_setzero_ps() );
+                    z = _mm_or_ps( _mm_andnot_ps( mask, z ), _mm_and_ps( mask, nan ) );
+                }
+
+                // Broadcast Depth to Components (z0 z0 z0 z1 | z1 z1 z2 z2 | z2 z3 z3 z3)
+                const __m128 z0 = _mm_shuffle_ps( z, z, _MM_SHUFFLE( 1, 0, 0, 0 ) );
+                const __m128 z1 = _mm_shuffle_ps( z, z, _MM_SHUFFLE( 2, 2, 1, 1 ) );
+                const __m128 z2 = _mm_shuffle_ps( z, z, _MM_SHUFFLE( 3, 3, 3, 2 ) );
+
+                const float* r = ray + i * 3;
+                __m128 p0 = _mm_mul_ps( _mm_loadu_ps( r + 0 ), z0 );
+                __m128 p1 = _mm_mul_ps( _mm_loadu_ps( r + 4 ), z1 );
+                __m128 p2 = _mm_mul_ps( _mm_loadu_ps( r + 8 ), z2 );
+                if( !invalid_as_nan ){
+                    p0 = _mm_and_ps( p0, _mm_cmpord_ps( p0, p0 ) );
+                    p1 = _mm_and_ps( p1, _mm_cmpord_ps( p1, p1 ) );
+                    p2 = _mm_and_ps( p2, _mm_cmpord_ps( p2, p2 ) );
+                }
+
+                float* d = dst + i * 3;
+                _mm_storeu_ps( d + 0, p0 );
+                _mm_storeu_ps( d + 4, p1 );
+                _mm_storeu_ps( d + 8, p2 );
+            }
+            compute_points_scalar( depth + i, ray + i * 3, dst + i * 3, count - i, invalid_as_nan );
+        }
+
+        // Compute Points of Row (8 points (24 values) per block)
+        __UNPROJECTION_TARGET__( "avx2" )
+        static void compute_points_avx2( const uint16_t* depth, const float* ray, float* dst, const int32_t count, const bool invalid_as_nan )
+        {
+            const __m256 nan = _mm256_set1_ps( std::numeric_limits<float>::quiet_NaN() );
+            const __m256i index0 = _mm256_setr_epi32( 0, 0, 0, 1, 1, 1, 2, 2 );
+            const __m256i index1 = _mm256_setr_epi32( 2, 3, 3, 3, 4, 4, 4, 5 );
+            const __m256i index2 = _mm256_setr_epi32( 5, 5, 6, 6, 6, 7, 7, 7 );
+            constexpr int32_t block = 8;
+            int32_t i = 0;
+            for( ; i + block <= count; i += block ){
+                const __m128i value = _mm_loadu_si128( reinterpret_cast<const __m128i*>( depth + i ) );
+                __m256 z = _mm256_cvtepi32_ps( _mm256_cvtepu16_epi32( value ) );
+                if( invalid_as_nan ){
+                    z = _mm256_blendv_ps( z, nan, _mm256_cmp_ps( z, _mm256_setzero_ps(), _CMP_EQ_OQ ) );
+                }
+
+                // Broadcast Depth to Components
+                const __m256 z0 = _mm256_permutevar8x32_ps( z, index0 );
+                const __m256 z1 = _mm256_permutevar8x32_ps( z, index1 );
+                const __m256 z2 = _mm256_permutevar8x32_ps( z, index2 );
+
+                const float* r = ray + i * 3;
+                __m256 p0 = _mm256_mul_ps( _mm256_loadu_ps( r +  0 ), z0 );
+                __m256 p1 = _mm256_mul_ps( _mm256_loadu_ps( r +  8 ), z1 );
+                __m256 p2 = _mm256_mul_ps( _mm256_loadu_ps( r + 16 ), z2 );
+                if( !invalid_as_nan ){
+                    p0 = _mm256_and_ps( p0, _mm256_cmp_ps( p0, p0, _CMP_ORD_Q ) );
+                    p1 = _mm256_and_ps( p1, _mm256_cmp_ps( p1, p1, _CMP_ORD_Q ) );
+                    p2 = _mm256_and_ps( p2, _mm256_cmp_ps( p2, p2, _CMP_ORD_Q ) );
+                }
+
+                float* d = dst + i * 3;
+                _mm256_storeu_ps( d +  0, p0 );
+                _mm256_storeu_ps( d +  8, p1 );
+                _mm256_storeu_ps( d + 16, p2 );
+            }
+            compute_points_scalar( depth + i, ray + i * 3, dst + i * 3, count - i, invalid_as_nan );
+        }
+        #endif
+    };
+}
+
+#endif // __UNPROJECTION__
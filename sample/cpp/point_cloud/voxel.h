@@ -0,0 +1,391 @@
+/*
+ This is utility to that provides hash-based voxel grid filter for downsampling point cloud.
+ Points are grouped by voxel (cube of leaf size), and each voxel is reduced to one point.
+ Hash tables are kept in filter and reused in every frame, so no allocation is needed once they grew enough.
+
+ k4a::voxel_grid voxel_grid( 10.0f, k4a::voxel_grid::policy::centroid );  // leaf size (mm), and policy
+ voxel_grid.filter( xyz, color, filtered_xyz, filtered_color );           // cv::Mat (CV_32FC3, invalid points are NaN) and color of points
+
+ It works in three phases on thread pool of OpenCV (cv::parallel_for_).
+ 1. Rows of point cloud are split into tiles, and voxel key and partition of each point are computed.
+    Indices of points are bucketed by partition with counting sort, so each partition touches only its own points.
+ 2. Each partition is reduced with its own hash table, so no synchronization is needed.
+ 3. Voxels of partitions are written to filtered point cloud (1xN) in parallel.
+
+ Copyright (c) 2019 Tsukasa Sugiura <t.sugiura0204@gmail.com>
+ Licensed under the MIT license.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef __VOXEL__
+#define __VOXEL__
+
+#include <k4a/k4a.hpp>
+#include <opencv2/opencv.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace k4a
+{
+    class voxel_grid
+    {
+    public:
+        // Policy to Reduce Points in Voxel
+        enum class policy
+        {
+            centroid, // Centroid of points, and average of colors
+            first     // First point (in order of rows) and its color
+        };
+
+    private:
+        // Voxel in Hash Table
+        // NOTE: Slot is empty if generation is not current generation, so table is cleared without touching slots.
+        struct voxel
+        {
+            uint64_t key;
+            uint32_t generation;
+            uint32_t count;
+            uint32_t first;
+            double x, y, z;
+            uint32_t color[4];
+        };
+
+        // Hash Table of Partition (Open addressing with linear probing, capacity is power of 2)
+        struct table
+        {
+            std::vector<voxel> slots;
+            std::vector<uint32_t> occupied;
+            uint32_t generation = 0;
+        };
+
+        static const uint8_t invalid_partition = 0xFF;
+        static const size_t max_partitions = 64;
+        static const size_t tiles_per_partition = 4;
+        static const size_t initial_capacity = 1024;
+        static const size_t max_channels = 4;
+
+        float leaf_size;
+        policy mode;
+
+        // Key and Partition of each Point (Invalid point is invalid_partition)
+        std::vector<uint64_t> keys;
+        std::vector<uint8_t> partitions;
+
+        // Indices of Points Bucketed by Partition (Points of partition p are indices[buckets[p]] to indices[buckets[p + 1] - 1] in order of rows)
+        // (tile_counts is number of points of each partition in each tile, and it is turned into offsets to scatter indices.)
+        std::vector<uint32_t> indices;
+        std::vector<size_t> buckets;
+        std::vector<size_t> tile_counts;
+
+        // Hash Tables of Partitions, and Offsets of Partitions in Filtered Point Cloud
+        std::vector<table> tables;
+        std::vector<size_t> offsets;
+
+    public:
+        voxel_grid( const float leaf = 10.0f, const policy reduction = policy::centroid )
+        {
+            reset( leaf, reduction );
+        }
+
+        // Reset Leaf Size (mm) and Policy
+        void reset( const float leaf, const policy reduction )
+        {
+            if( !( leaf > 0.0f ) ){
+                throw k4a::error( "Failed to reset voxel grid! (leaf size must be positive)" );
+            }
+
+            leaf_size = leaf;
+            mode = reduction;
+        }
+
+        float get_leaf_size() const
+        {
+            return leaf_size;
+        }
+
+        policy get_policy() const
+        {
+            return mode;
+        }
+
+        // Filter Point Cloud
+        // (xyz is CV_32FC3 (invalid points are NaN or (0,0,0)), color is same size as xyz (up to 4 channels of 8 bits), or empty.)
+        // (filtered_xyz is 1xN CV_32FC3, and filtered_color is 1xN of same type as color.)
+        void filter( const cv::Mat& xyz, const cv::Mat& color, cv::Mat& filtered_xyz, cv::Mat& filtered_color )
+        {
+            if( xyz.type() != CV_32FC3 ){
+                throw k4a::error( "Failed to filter point cloud! (type of point cloud must be CV_32FC3)" );
+            }
+            const bool has_color = !color.empty();
+            if( has_color && ( color.rows != xyz.rows || color.cols != xyz.cols || color.depth() != CV_8U || color.channels() > static_cast<int32_t>( max_channels ) ) ){
+                throw k4a::error( "Failed to filter point cloud! (color must be same size as point cloud, and up to 4 channels of 8 bits)" );
+            }
+
+            const int32_t rows = xyz.rows;
+            const int32_t cols = xyz.cols;
+            const size_t count = static_cast<size_t>( rows ) * cols;
+            keys.resize( count );
+            partitions.resize( count );
+
+            // Number of Partitions (Same as number of threads, they are up to max_partitions)
+            const size_t partition_count = std::min( std::max( static_cast<size_t>( cv::getNumThreads() ), static_cast<size_t>( 1 ) ), static_cast<size_t>( max_partitions ) );
+            if( tables.size() < partition_count ){
+                tables.resize( partition_count );
+            }
+
+            // Tiles of Rows (Fixed split, so that indices are scattered in same order as they are counted)
+            const int32_t tile_count = std::max( std::min( rows, static_cast<int32_t>( partition_count * tiles_per_partition ) ), 1 );
+            tile_counts.assign( static_cast<size_t>( tile_count ) * partition_count, 0 );
+
+            // Compute Keys and Partitions of Points, and Count Points of Partitions in Tiles
+            const float inverse_leaf = 1.0f / leaf_size;
+            cv::parallel_for_( cv::Range( 0, tile_count ), [&]( const cv::Range& range ){
+                for( int32_t tile = range.start; tile < range.end; tile++ ){
+                    size_t* counts = &tile_counts[static_cast<size_t>( tile ) * partition_count];
+                    for( int32_t y = get_tile_row( tile, tile_count, rows ); y < get_tile_row( tile + 1, tile_count, rows ); y++ ){
+                        const float* point = xyz.ptr<float>( y );
+                        uint64_t* key = &keys[static_cast<size_t>( y ) * cols];
+                        uint8_t* partition = &partitions[static_cast<size_t>( y ) * cols];
+                        for( int32_t x = 0; x < cols; x++, point += 3 ){
+                            if( !is_valid( point ) ){
+                                partition[x] = invalid_partition;
+                                continue;
+                            }
+                            key[x] = get_key( point, inverse_leaf );
+                            partition[x] = static_cast<uint8_t>( ( hash( key[x] ) >> 32 ) % partition_count );
+                            counts[partition[x]]++;
+                        }
+                    }
+                }
+            } );
+
+            // Compute Buckets of Partitions, and Offsets of Tiles in Buckets (Exclusive prefix sum in order of partitions and tiles)
+            buckets.assign( partition_count + 1, 0 );
+            size_t total = 0;
+            for( size_t p = 0; p < partition_count; p++ ){
+                buckets[p] = total;
+                for( int32_t tile = 0; tile < tile_count; tile++ ){
+                    size_t& count = tile_counts[static_cast<size_t>( tile ) * partition_count + p];
+                    const size_t offset = total;
+                    total += count;
+                    count = offset;
+                }
+            }
+            buckets[partition_count] = total;
+            indices.resize( total );
+
+            // Scatter Indices of Points to Buckets of Partitions
+            cv::parallel_for_( cv::Range( 0, tile_count ), [&]( const cv::Range& range ){
+                for( int32_t tile = range.start; tile < range.end; tile++ ){
+                    size_t* offsets = &tile_counts[static_cast<size_t>( tile ) * partition_count];
+                    for( int32_t y = get_tile_row( tile, tile_count, rows ); y < get_tile_row( tile + 1, tile_count, rows ); y++ ){
+                        const size_t row = static_cast<size_t>( y ) * cols;
+                        const uint8_t* partition = &partitions[row];
+                        for( int32_t x = 0; x < cols; x++ ){
+                            if( partition[x] != invalid_partition ){
+                                indices[offsets[partition[x]]++] = static_cast<uint32_t>( row + x );
+                            }
+                        }
+                    }
+                }
+            } );
+
+            // Reduce Points of Partitions into Voxels
+            const size_t channels = has_color ? static_cast<size_t>( color.channels() ) : 0;
+            cv::parallel_for_( cv::Range( 0, static_cast<int32_t>( partition_count ) ), [&]( const cv::Range& range ){
+                for( int32_t p = range.start; p < range.end; p++ ){
+                    reduce( xyz, color, channels, static_cast<size_t>( p ), tables[p] );
+                }
+            } );
+
+            // Compute Offsets of Partitions in Filtered Point Cloud
+            offsets.assign( partition_count + 1, 0 );
+            for( size_t p = 0; p < partition_count; p++ ){
+                offsets[p + 1] = offsets[p] + tables[p].occupied.size();
+            }
+            const int32_t voxels = static_cast<int32_t>( offsets[partition_count] );
+
+            // Write Voxels to Filtered Point Cloud
+            filtered_xyz.create( 1, voxels, CV_32FC3 );
+            if( has_color ){
+                filtered_color.create( 1, voxels, color.type() );
+            }
+            else{
+                filtered_color.release();
+            }
+            if( voxels == 0 ){
+                return;
+            }
+
+            cv::parallel_for_( cv::Range( 0, static_cast<int32_t>( partition_count ) ), [&]( const cv::Range& range ){
+                for( int32_t p = range.start; p < range.end; p++ ){
+                    const table& partition = tables[p];
+                    float* dst_xyz = filtered_xyz.ptr<float>( 0 ) + offsets[p] * 3;
+                    uint8_t* dst_color = has_color ? filtered_color.ptr<uint8_t>( 0 ) + offsets[p] * channels : nullptr;
+                    for( const uint32_t index : partition.occupied ){
+                        const voxel& v = partition.slots[index];
+                        if( mode == policy::centroid ){
+                            dst_xyz[0] = static_cast<float>( v.x / v.count );
+                            dst_xyz[1] = static_cast<float>( v.y / v.count );
+                            dst_xyz[2] = static_cast<float>( v.z / v.count );
+                            for( size_t c = 0; c < channels; c++ ){
+                                dst_color[c] = static_cast<uint8_t>( ( v.color[c] + v.count / 2 ) / v.count );
+                            }
+                        }
+                        else{
+                            const int32_t y = static_cast<int32_t>( v.first / cols );
+                            const int32_t x = static_cast<int32_t>( v.first % cols );
+                            const float* point = xyz.ptr<float>( y ) + x * 3;
+                            std::copy( point, point + 3, dst_xyz );
+                            if( has_color ){
+                                const uint8_t* src = color.ptr<uint8_t>( y ) + x * channels;
+                                std::copy( src, src + channels, dst_color );
+                            }
+                        }
+                        dst_xyz += 3;
+                        dst_color += channels;
+                    }
+                }
+            } );
+        }
+
+    private:
+        // Get First Row of Tile
+        static int32_t get_tile_row( const int32_t tile, const int32_t tile_count, const int32_t rows )
+        {
+            return static_cast<int32_t>( static_cast<int64_t>( rows ) * tile / tile_count );
+        }
+
+        // Check Point is Valid (Not NaN and not (0,0,0))
+        static bool is_valid( const float* point )
+        {
+            return !std::isnan( point[0] ) && !std::isnan( point[1] ) && !std::isnan( point[2] ) &&
+                   !( point[0] == 0.0f && point[1] == 0.0f && point[2] == 0.0f );
+        }
+
+        // Get Key of Voxel (Indices of 21 bits per axis, about +/-1 million voxels)
+        static uint64_t get_key( const float* point, const float inverse_leaf )
+        {
+            constexpr int64_t offset = int64_t( 1 ) << 20;
+            constexpr uint64_t mask = ( uint64_t( 1 ) << 21 ) - 1;
+            const uint64_t ix = static_cast<uint64_t>( static_cast<int64_t>( std::floor( point[0] * inverse_leaf ) ) + offset ) & mask;
+            const uint64_t iy = static_cast<uint64_t>( static_cast<int64_t>( std::floor( point[1] * inverse_leaf ) ) + offset ) & mask;
+            const uint64_t iz = static_cast<uint64_t>( static_cast<int64_t>( std::floor( point[2] * inverse_leaf ) ) + offset ) & mask;
+            return ( ix << 42 ) | ( iy << 21 ) | iz;
+        }
+
+        // Hash of Key (Finalizer of SplitMix64)
+        static uint64_t hash( uint64_t key )
+        {
+            key = ( key ^ ( key >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+            key = ( key ^ ( key >> 27 ) ) * 0x94D049BB133111EBull;
+            return key ^ ( key >> 31 );
+        }
+
+        // Reduce Points of Partition into Voxels with Hash Table of Partition
+        void reduce( const cv::Mat& xyz, const cv::Mat& color, const size_t channels, const size_t partition, table& voxels ) const
+        {
+            // Clear Table (Slots of previous generation are empty)
+            if( voxels.slots.empty() ){
+                voxels.slots.resize( initial_capacity );
+            }
+            voxels.occupied.clear();
+            if( ++voxels.generation == 0 ){
+                for( voxel& slot : voxels.slots ){
+                    slot.generation = 0;
+                }
+                voxels.generation = 1;
+            }
+
+            // Points of Partition (Bucketed in order of rows)
+            const uint32_t cols = static_cast<uint32_t>( xyz.cols );
+            for( size_t i = buckets[partition]; i < buckets[partition + 1]; i++ ){
+                const uint32_t index = indices[i];
+
+                // Grow Table if Load Factor Exceeds 1/2
+                if( ( voxels.occupied.size() + 1 ) * 2 > voxels.slots.size() ){
+                    grow( voxels );
+                }
+
+                const uint64_t key = keys[index];
+                voxel& v = voxels.slots[find( voxels, key )];
+                if( v.generation != voxels.generation ){
+                    v.key = key;
+                    v.generation = voxels.generation;
+                    v.count = 0;
+                    v.first = index;
+                    v.x = v.y = v.z = 0.0;
+                    std::fill( v.color, v.color + max_channels, 0u );
+                    voxels.occupied.push_back( static_cast<uint32_t>( &v - voxels.slots.data() ) );
+                }
+                v.count++;
+
+                // First point is kept as is, so accumulation is not needed
+                if( mode == policy::first ){
+                    continue;
+                }
+                const int32_t y = static_cast<int32_t>( index / cols );
+                const int32_t x = static_cast<int32_t>( index % cols );
+                const float* point = xyz.ptr<float>( y ) + x * 3;
+                v.x += point[0];
+                v.y += point[1];
+                v.z += point[2];
+                if( channels > 0 ){
+                    const uint8_t* c = color.ptr<uint8_t>( y ) + x * channels;
+                    for( size_t k = 0; k < channels; k++ ){
+                        v.color[k] += c[k];
+                    }
+                }
+            }
+        }
+
+        // Find Slot of Key (Slot of key, or empty slot where key should be inserted)
+        static size_t find( const table& voxels, const uint64_t key )
+        {
+            const size_t mask = voxels.slots.size() - 1;
+            size_t index = static_cast<size_t>( hash( key ) ) & mask;
+            while( true ){
+                const voxel& slot = voxels.slots[index];
+                if( slot.generation != voxels.generation || slot.key == key ){
+                    return index;
+                }
+                index = ( index + 1 ) & mask;
+            }
+        }
+
+        // Grow Table to Double Capacity, and Rehash Voxels of Current Generation
+        static void grow( table& voxels )
+        {
+            // NOTE: New slots are empty, because generation is 0 and current generation is always more than 0.
+            std::vector<voxel> slots( voxels.slots.size() * 2 );
+            std::swap( voxels.slots, slots );
+            for( uint32_t& index : voxels.occupied ){
+                const size_t destination = find( voxels, slots[index].key );
+                voxels.slots[destination] = slots[index];
+                index = static_cast<uint32_t>( destination );
+            }
+        }
+    };
+}
+
+#endif // __VOXEL__
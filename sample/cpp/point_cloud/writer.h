@@ -0,0 +1,395 @@
+/*
+ This is utility to that provides streaming writer of point cloud to binary PLY and PCD files.
+ Points are written directly from point cloud image (int16x3, mm) and color image (BGRA) without conversion,
+ and files are written on background thread through bounded queue, so disk stall doesn't stall main loop.
+
+ k4a::point_cloud_writer writer( k4a::point_cloud_writer::format::ply, true );   // format, and skip invalid points
+ k4a::image xyz_image = writer.get_xyz_image( width, height );                  // buffer is recycled after written
+ unprojection.compute( transformed_depth_image, xyz_image );
+ writer.push( "cloud_000000.ply", xyz_image, color_image );                     // color_image is BGRA of same size, or empty
+ writer.close();                                                                // wait until all files are written
+
+ Encoded frame (e.g. k4a::cloud_encoder) can be written as is through the same queue.
+
+ std::vector<uint8_t> data = writer.get_data();                                  // buffer is recycled after written
+ encoder.encode( calibration, K4A_CALIBRATION_TYPE_COLOR, transformed_depth_image, color_image, data );
+ writer.push( "cloud_000000.k4dc", std::move( data ) );
+
+ PLY has properties "short x, y, z" and "uchar blue, green, red, alpha" per vertex.
+ PCD has fields "x y z" (I 2) and "rgb" (U 4, 0xAARRGGBB), and it is organized (WIDTH x HEIGHT) if invalid points are not skipped.
+ NOTE: Buffers are written as is, so values are little-endian on x86 and ARM.
+
+ Copyright (c) 2019 Tsukasa Sugiura <t.sugiura0204@gmail.com>
+ Licensed under the MIT license.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef __WRITER__
+#define __WRITER__
+
+#include <k4a/k4a.hpp>
+
+#include "pipeline.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+namespace k4a
+{
+    class point_cloud_writer
+    {
+    public:
+        // Format of File
+        enum class format
+        {
+            ply,
+            pcd
+        };
+
+    private:
+        // Point Cloud to be Written
+        struct job
+        {
+            std::string path;
+            k4a::image xyz_image;
+            k4a::image color_image;
+            bool recycle_xyz;
+            bool recycle_color;
+            std::vector<uint8_t> data; // Bytes that are written as is (if point cloud image is empty)
+        };
+
+        static const size_t point_size = 3 * sizeof( int16_t );
+        static const size_t color_size = 4 * sizeof( uint8_t );
+
+        format type;
+        bool skip_invalid;
+
+        // Queue to Writing Thread
+        k4a::bounded_queue<job> queue;
+        std::thread thread;
+
+        // Recycled Images, and Handles of Images that are Lent by get_xyz_image() or get_color_image()
+        // NOTE: Only images created by writer are recycled, images of capture may be still shared with others.
+        std::vector<k4a::image> free_images;
+        std::vector<k4a_image_t> lent_images;
+        std::vector<std::vector<uint8_t>> free_data;
+        std::mutex mutex;
+
+        // Buffer of Records in Row (Used only in writing thread)
+        std::vector<char> row;
+
+        std::atomic<uint64_t> written;
+        std::atomic<uint64_t> failed;
+
+    public:
+        // Constructor (Format, skip invalid points, and capacity and policy of queue)
+        // (Main loop waits if queue is full with k4a::drop_policy::block, or the oldest point cloud is dropped with k4a::drop_policy::drop_oldest.)
+        point_cloud_writer( const format type, const bool skip_invalid = true, const size_t capacity = 4, const k4a::drop_policy policy = k4a::drop_policy::block )
+            : type( type ),
+              skip_invalid( skip_invalid ),
+              queue( capacity, policy ),
+              written( 0 ),
+              failed( 0 )
+        {
+            thread = std::thread( &point_cloud_writer::write_stage, this );
+        }
+
+        ~point_cloud_writer()
+        {
+            close();
+        }
+
+        // Get Point Cloud Image (K4A_IMAGE_FORMAT_CUSTOM, int16x3) to be Pushed
+        // (Image that has been written is recycled, so no allocation is needed in steady state. It must be pushed after it is filled.)
+        k4a::image get_xyz_image( const int32_t width, const int32_t height )
+        {
+            return get_image( K4A_IMAGE_FORMAT_CUSTOM, width, height, static_cast<int32_t>( point_size ) );
+        }
+
+        // Get Color Image (K4A_IMAGE_FORMAT_COLOR_BGRA32) to be Pushed
+        // (It is used when color image of capture can't be pushed as is, e.g. color is sampled in region of point cloud.)
+        k4a::image get_color_image( const int32_t width, const int32_t height )
+        {
+            return get_image( K4A_IMAGE_FORMAT_COLOR_BGRA32, width, height, static_cast<int32_t>( color_size ) );
+        }
+
+        // Push Point Cloud to be Written on Background Thread (Return false if writer was closed)
+        // (Images are held by reference count until written, so they must not be overwritten after pushed.)
+        bool push( const std::string& path, const k4a::image& xyz_image, const k4a::image& color_image = k4a::image() )
+        {
+            if( !xyz_image.handle() ){
+                throw k4a::error( "Failed to push point cloud! (point cloud image is empty)" );
+            }
+            if( color_image.handle() && ( color_image.get_format() != K4A_IMAGE_FORMAT_COLOR_BGRA32 || color_image.get_width_pixels() != xyz_image.get_width_pixels() || color_image.get_height_pixels() != xyz_image.get_height_pixels() ) ){
+                throw k4a::error( "Failed to push point cloud! (color image must be BGRA image of same size as point cloud image)" );
+            }
+
+            job value;
+            value.path = path;
+            value.xyz_image = xyz_image;
+            value.color_image = color_image;
+            value.recycle_xyz = take_lent( xyz_image );
+            value.recycle_color = take_lent( color_image );
+            return queue.push( std::move( value ) );
+        }
+
+        // Get Buffer of Bytes to be Pushed (Buffer that has been written is recycled, so its capacity is reused)
+        std::vector<uint8_t> get_data()
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            if( free_data.empty() ){
+                return std::vector<uint8_t>();
+            }
+            std::vector<uint8_t> data = std::move( free_data.back() );
+            free_data.pop_back();
+            return data;
+        }
+
+        // Push Bytes to be Written to File as is on Background Thread (Return false if writer was closed)
+        bool push( const std::string& path, std::vector<uint8_t>&& data )
+        {
+            job value;
+            value.path = path;
+            value.recycle_xyz = false;
+            value.recycle_color = false;
+            value.data = std::move( data );
+            return queue.push( std::move( value ) );
+        }
+
+        // Close Writer (Wait until all pushed point clouds are written)
+        void close()
+        {
+            queue.close();
+            if( thread.joinable() ){
+                thread.join();
+            }
+        }
+
+        // Get Number of Written Files
+        uint64_t get_written() const
+        {
+            return written.load( std::memory_order_relaxed );
+        }
+
+        // Get Number of Files that were Failed to Write
+        uint64_t get_failed() const
+        {
+            return failed.load( std::memory_order_relaxed );
+        }
+
+        // Get Number of Point Clouds that were Dropped in Queue
+        uint64_t get_dropped() const
+        {
+            return queue.get_dropped();
+        }
+
+    private:
+        // Get Recycled Image, or Create Image
+        k4a::image get_image( const k4a_image_format_t format, const int32_t width, const int32_t height, const int32_t pixel_size )
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            k4a::image image;
+            for( size_t i = 0; i < free_images.size(); i++ ){
+                if( free_images[i].get_format() == format && free_images[i].get_width_pixels() == width && free_images[i].get_height_pixels() == height ){
+                    image = std::move( free_images[i] );
+                    free_images[i] = std::move( free_images.back() );
+                    free_images.pop_back();
+                    break;
+                }
+            }
+            if( !image.handle() ){
+                image = k4a::image::create( format, width, height, width * pixel_size );
+            }
+            lent_images.push_back( image.handle() );
+            return image;
+        }
+
+        // Take Image from Lent Images (Return true if image was lent by writer)
+        bool take_lent( const k4a::image& image )
+        {
+            if( !image.handle() ){
+                return false;
+            }
+            std::lock_guard<std::mutex> lock( mutex );
+            const std::vector<k4a_image_t>::iterator it = std::find( lent_images.begin(), lent_images.end(), image.handle() );
+            if( it == lent_images.end() ){
+                return false;
+            }
+            lent_images.erase( it );
+            return true;
+        }
+
+        // Writing Thread
+        void write_stage()
+        {
+            job value;
+            while( queue.pop( value ) ){
+                try{
+                    if( value.xyz_image.handle() ){
+                        write( value.path, value.xyz_image, value.color_image );
+                    }
+                    else{
+                        write( value.path, value.data );
+                    }
+                    written.fetch_add( 1, std::memory_order_relaxed );
+                }
+                catch( const k4a::error& ){
+                    failed.fetch_add( 1, std::memory_order_relaxed );
+                }
+
+                // Recycle Images that were Lent by Writer
+                {
+                    std::lock_guard<std::mutex> lock( mutex );
+                    if( value.recycle_xyz ){
+                        free_images.push_back( std::move( value.xyz_image ) );
+                    }
+                    if( value.recycle_color ){
+                        free_images.push_back( std::move( value.color_image ) );
+                    }
+                    if( value.data.capacity() > 0 ){
+                        value.data.clear();
+                        free_data.push_back( std::move( value.data ) );
+                    }
+                }
+                value.xyz_image.reset();
+                value.color_image.reset();
+            }
+        }
+
+        // Write Point Cloud to File
+        void write( const std::string& path, const k4a::image& xyz_image, const k4a::image& color_image )
+        {
+            std::ofstream stream( path, std::ios::binary | std::ios::trunc );
+            if( !stream.is_open() ){
+                throw k4a::error( "Failed to open point cloud file!" );
+            }
+
+            const int32_t width = xyz_image.get_width_pixels();
+            const int32_t height = xyz_image.get_height_pixels();
+            const bool has_color = color_image.handle() != nullptr;
+            const uint64_t count = skip_invalid ? count_valid( xyz_image ) : static_cast<uint64_t>( width ) * height;
+
+            // Write Header
+            const std::string header = ( type == format::ply ) ? get_ply_header( count, has_color ) : get_pcd_header( count, width, height, has_color );
+            stream.write( header.data(), static_cast<std::streamsize>( header.size() ) );
+
+            // Write Records of Rows (x, y, z, and BGRA)
+            const size_t record_size = point_size + ( has_color ? color_size : 0 );
+            row.resize( static_cast<size_t>( width ) * record_size );
+            for( int32_t y = 0; y < height; y++ ){
+                const int16_t* points = reinterpret_cast<const int16_t*>( xyz_image.get_buffer() + static_cast<size_t>( y ) * xyz_image.get_stride_bytes() );
+                const uint8_t* colors = has_color ? color_image.get_buffer() + static_cast<size_t>( y ) * color_image.get_stride_bytes() : nullptr;
+                char* record = row.data();
+                for( int32_t x = 0; x < width; x++ ){
+                    const int16_t* point = points + x * 3;
+                    if( skip_invalid && point[2] == 0 ){
+                        continue;
+                    }
+                    std::memcpy( record, point, point_size );
+                    if( has_color ){
+                        std::memcpy( record + point_size, colors + x * color_size, color_size );
+                    }
+                    record += record_size;
+                }
+                stream.write( row.data(), static_cast<std::streamsize>( record - row.data() ) );
+            }
+
+            if( !stream ){
+                throw k4a::error( "Failed to write point cloud file!" );
+            }
+        }
+
+        // Write Bytes to File as is
+        static void write( const std::string& path, const std::vector<uint8_t>& data )
+        {
+            std::ofstream stream( path, std::ios::binary | std::ios::trunc );
+            if( !stream.is_open() ){
+                throw k4a::error( "Failed to open file!" );
+            }
+            stream.write( reinterpret_cast<const char*>( data.data() ), static_cast<std::streamsize>( data.size() ) );
+            if( !stream ){
+                throw k4a::error( "Failed to write file!" );
+            }
+        }
+
+        // Count Valid Points (Invalid point is (0,0,0))
+        static uint64_t count_valid( const k4a::image& xyz_image )
+        {
+            uint64_t count = 0;
+            for( int32_t y = 0; y < xyz_image.get_height_pixels(); y++ ){
+                const int16_t* points = reinterpret_cast<const int16_t*>( xyz_image.get_buffer() + static_cast<size_t>( y ) * xyz_image.get_stride_bytes() );
+                for( int32_t x = 0; x < xyz_image.get_width_pixels(); x++ ){
+                    count += ( points[x * 3 + 2] != 0 );
+                }
+            }
+            return count;
+        }
+
+        // Get Header of PLY
+        static std::string get_ply_header( const uint64_t count, const bool has_color )
+        {
+            std::ostringstream header;
+            header << "ply\n"
+                   << "format binary_little_endian 1.0\n"
+                   << "comment unit mm\n"
+                   << "element vertex " << count << "\n"
+                   << "property short x\n"
+                   << "property short y\n"
+                   << "property short z\n";
+            if( has_color ){
+                header << "property uchar blue\n"
+                       << "property uchar green\n"
+                       << "property uchar red\n"
+                       << "property uchar alpha\n";
+            }
+            header << "end_header\n";
+            return header.str();
+        }
+
+        // Get Header of PCD
+        // (Point cloud is organized if invalid points are not skipped.)
+        std::string get_pcd_header( const uint64_t count, const int32_t width, const int32_t height, const bool has_color ) const
+        {
+            std::ostringstream header;
+            header << "# .PCD v0.7 - Point Cloud Data file format (unit mm)\n"
+                   << "VERSION 0.7\n"
+                   << ( has_color ? "FIELDS x y z rgb\n" : "FIELDS x y z\n" )
+                   << ( has_color ? "SIZE 2 2 2 4\n"     : "SIZE 2 2 2\n" )
+                   << ( has_color ? "TYPE I I I U\n"     : "TYPE I I I\n" )
+                   << ( has_color ? "COUNT 1 1 1 1\n"    : "COUNT 1 1 1\n" )
+                   << "WIDTH " << ( skip_invalid ? count : static_cast<uint64_t>( width ) ) << "\n"
+                   << "HEIGHT " << ( skip_invalid ? 1 : height ) << "\n"
+                   << "VIEWPOINT 0 0 0 1 0 0 0\n"
+                   << "POINTS " << count << "\n"
+                   << "DATA binary\n";
+            return header.str();
+        }
+    };
+}
+
+#endif // __WRITER__
@@ -1,14 +1,26 @@
 #include "kinect.hpp"
 #include "util.h"
 
+#include <atomic>
 #include <chrono>
+#include <csignal>
 #include <ctime>
 #include <iomanip>
 #include <ostream>
 
 // Constructor
 kinect::kinect( const uint32_t index )
-    : device_index( index )
+    : device_index( index ),
+      write_queue( 30, k4a::drop_policy::drop_oldest ),
+      flush_interval( 1000 ),
+      written_count( 0 ),
+      written_bytes( 0 ),
+      flush_count( 0 ),
+      headless( false ),
+      preview_interval( 1 ),
+      preview_scale( 1 ),
+      frame_count( 0 ),
+      preview_frame( false )
 {
     // Initialize
     initialize();
@@ -33,23 +45,17 @@ void kinect::initialize()
 // Initialize Sensor
 inline void kinect::initialize_sensor()
 {
-    // Get Connected Devices
-    const int32_t device_count = k4a::device::get_installed_count();
-    if( device_count == 0 ){
-        throw k4a::error( "Failed to found device!" );
-    }
-
-    // Open Device
-    device = k4a::device::open( device_index );
-
-    // Start Cameras with Configuration
+    // Configuration
     device_configuration = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
     device_configuration.color_format             = k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_MJPG;
     device_configuration.color_resolution         = k4a_color_resolution_t::K4A_COLOR_RESOLUTION_720P;
     device_configuration.depth_mode               = k4a_depth_mode_t::K4A_DEPTH_MODE_NFOV_UNBINNED;
     device_configuration.synchronized_images_only = true;
     device_configuration.wired_sync_mode          = k4a_wired_sync_mode_t::K4A_WIRED_SYNC_MODE_STANDALONE;
-    device.start_cameras( &device_configuration );
+
+    // Open Device and Start Cameras
+    // (Synthetic source is used instead of device if K4A_SOURCE=synthetic is set.)
+    source = k4a::open_source( device_index, device_configuration );
 }
 
 // Initialize Record
@@ -70,45 +76,109 @@ inline void kinect::initialize_record()
 
     // Create Record
     record_file = "./" + oss.str() + ".mkv";
+    // NOTE: Calibration and serial number are written from device. They are not written if source isn't device (e.g. synthetic source).
+    const k4a::device no_device;
+    const k4a::device& device = source->get_device() ? *source->get_device() : no_device;
+    if( !source->get_device() ){
+        std::cout << "warning: calibration is not written to record, because source is not device" << std::endl;
+    }
     record = k4a::record::create( record_file.generic_string().c_str(), device, device_configuration );
     std::cout << record_file.generic_string().c_str() << std::endl;
 
     // Write Header
     record.write_header();
+
+    // Start Write Thread
+    // NOTE: Captures are written on this thread, so that disk stall doesn't stall getting captures from device.
+    write_start = std::chrono::steady_clock::now();
+    write_thread = std::thread( &kinect::write_stage, this );
 }
 
 // Finalize
 void kinect::finalize()
 {
-    // Flash Record
-    record.flush();
+    // Stop Write Thread (Remaining captures in queue are written before stop)
+    write_queue.close();
+    if( write_thread.joinable() ){
+        write_thread.join();
+    }
+
+    // Flash Record (Record is not flushed if writing was failed)
+    if( !write_error ){
+        record.flush();
+    }
+
+    // Show Statistics
+    const double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - write_start ).count();
+    std::cout << "written    : " << written_count << " captures" << std::endl;
+    std::cout << "dropped    : " << write_queue.get_dropped() << " captures" << std::endl;
+    std::cout << "high water : " << write_queue.get_high_water_mark() << " captures in queue" << std::endl;
+    std::cout << "throughput : " << written_bytes / seconds / ( 1024.0 * 1024.0 ) << " MB/s" << std::endl;
+    std::cout << "flushed    : " << flush_count << " times" << std::endl;
+    if( write_error ){
+        std::cout << "warning: writing was failed, record may be truncated" << std::endl;
+    }
 
     // Close Record
     record.close();
 
-    // Stop Cameras
-    device.stop_cameras();
-
-    // Close Device
-    device.close();
+    // Stop Cameras and Close Device
+    source->stop();
 
     // Close Window
     cv::destroyAllWindows();
 }
 
+// Interrupt Flag for Headless Mode (Set by Ctrl+C)
+static std::atomic<bool> interrupted( false );
+
+static void interrupt( int )
+{
+    interrupted = true;
+}
+
+// Configure Preview
+void kinect::configure_preview( const bool headless, const uint32_t interval, const int32_t scale )
+{
+    if( interval == 0 ){
+        throw k4a::error( "Preview interval must be greater than 0!" );
+    }
+
+    if( scale != 1 && scale != 2 && scale != 4 && scale != 8 ){
+        throw k4a::error( "Preview scale must be 1, 2, 4, or 8!" );
+    }
+
+    this->headless = headless;
+    preview_interval = interval;
+    preview_scale = scale;
+}
+
 // Run
 void kinect::run()
 {
+    // Headless Loop (Record until Ctrl+C without Window)
+    if( headless ){
+        std::signal( SIGINT, interrupt );
+        std::cout << "recording... (press Ctrl+C to stop)" << std::endl;
+        while( !interrupted ){
+            update();
+        }
+        return;
+    }
+
     // Main Loop
     while (true){
         // Update
         update();
 
-        // Draw
-        draw();
+        // Draw and Show only Preview Frame
+        if( preview_frame ){
+            // Draw
+            draw();
 
-        // Show
-        show();
+            // Show
+            show();
+        }
 
         // Wait Key
         constexpr int32_t delay = 1;
@@ -128,11 +198,15 @@ void kinect::update()
     // Write Frame
     write_frame();
 
-    // Update Color
-    update_color();
+    // Retrieve Images only for Preview Frame
+    preview_frame = !headless && ( frame_count++ % preview_interval == 0 );
+    if( preview_frame ){
+        // Update Color
+        update_color();
 
-    // Update Depth
-    update_depth();
+        // Update Depth
+        update_depth();
+    }
 
     // Release Capture Handle
     capture.reset();
@@ -143,7 +217,7 @@ inline void kinect::update_frame()
 {
     // Get Capture Frame
     constexpr std::chrono::milliseconds time_out( K4A_WAIT_INFINITE );
-    const bool result = device.get_capture( &capture, time_out );
+    const bool result = source->get_capture( &capture, time_out );
     if( !result ){
         throw k4a::error( "Failed to capture!" );
     }
@@ -152,8 +226,54 @@ inline void kinect::update_frame()
 // Write Frame
 inline void kinect::write_frame()
 {
-    // Write Capture Frame
-    record.write_capture( capture );
+    // Push Capture Frame to Write Thread
+    // (Queue is closed by write thread if writing was failed, then the error is rethrown on this thread.)
+    if( !write_queue.push( capture ) ){
+        if( write_thread.joinable() ){
+            write_thread.join();
+        }
+        if( write_error ){
+            std::rethrow_exception( write_error );
+        }
+    }
+}
+
+// Write Stage
+void kinect::write_stage()
+{
+    std::chrono::steady_clock::time_point flush_time = std::chrono::steady_clock::now();
+
+    k4a::capture capture;
+    while( write_queue.pop( capture ) ){
+        try{
+            // Write Capture Frame
+            record.write_capture( capture );
+            written_count++;
+
+            // Count Written Bytes
+            const k4a::image images[] = { capture.get_color_image(), capture.get_depth_image(), capture.get_ir_image() };
+            for( const k4a::image& image : images ){
+                if( image.handle() ){
+                    written_bytes += image.get_size();
+                }
+            }
+            capture.reset();
+
+            // Flush Record Periodically
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if( now - flush_time >= flush_interval ){
+                record.flush();
+                flush_time = now;
+                flush_count++;
+            }
+        }
+        catch( ... ){
+            // Keep Error to Rethrow on Main Thread, and Close Queue to Stop Pushing (e.g. disk is full)
+            write_error = std::current_exception();
+            write_queue.close();
+            break;
+        }
+    }
 }
 
 // Update Color
@@ -188,7 +308,8 @@ inline void kinect::draw_color()
     }
 
     // Get cv::Mat from k4a::image
-    color = k4a::get_mat( color_image );
+    // (Motion JPEG is decoded at reduced resolution using DCT scaling, and kept in BGR because it is only for preview.)
+    color = k4a::get_mat( color_image, static_cast<k4a::decode_scale>( preview_scale ), false );
 
     // Release Color Image Handle
     color_image.reset();
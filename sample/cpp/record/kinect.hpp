@@ -5,6 +5,13 @@
 #include <k4arecord/record.hpp>
 #include <opencv2/opencv.hpp>
 
+#include "pipeline.h"
+#include "source.h"
+
+#include <thread>
+#include <chrono>
+#include <exception>
+
 #if __has_include(<filesystem>)
 #include <filesystem>
 namespace filesystem = std::filesystem;
@@ -21,13 +28,30 @@ class kinect
 {
 private:
     // Kinect
-    k4a::device device;
+    std::unique_ptr<k4a::capture_source> source;
     k4a::record record;
     k4a::capture capture;
     k4a_device_configuration_t device_configuration;
     uint32_t device_index;
     filesystem::path record_file;
 
+    // Writer
+    k4a::bounded_queue<k4a::capture> write_queue;
+    std::thread write_thread;
+    std::chrono::milliseconds flush_interval;
+    uint64_t written_count;
+    uint64_t written_bytes;
+    uint64_t flush_count;
+    std::chrono::steady_clock::time_point write_start;
+    std::exception_ptr write_error;
+
+    // Preview
+    bool headless;
+    uint32_t preview_interval;
+    int32_t preview_scale;
+    uint64_t frame_count;
+    bool preview_frame;
+
     // Color
     k4a::image color_image;
     cv::Mat color;
@@ -43,6 +67,10 @@ public:
     // Destructor
     ~kinect();
 
+    // Configure Preview
+    // (headless: don't decode and show any frames, interval: decode and show every Nth frame, scale: decode color at 1/scale resolution (1, 2, 4, 8))
+    void configure_preview( const bool headless, const uint32_t interval = 1, const int32_t scale = 1 );
+
     // Run
     void run();
 
@@ -68,6 +96,9 @@ private:
     // Finalize
     void finalize();
 
+    // Write Stage
+    void write_stage();
+
     // Update Frame
     void update_frame();
 
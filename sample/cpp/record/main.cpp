@@ -1,13 +1,53 @@
 #include <iostream>
 #include <sstream>
+#include <string>
 
 #include "kinect.hpp"
 
+// Show Usage (Return error code of invalid options)
+int usage( const char* name )
+{
+    std::cout << "usage: " << name << " [--headless] [--preview-rate <N>] [--preview-scale <1|2|4|8>]" << std::endl;
+    return -1;
+}
+
 int main(int argc, char *argv[])
 {
+    // Parse Options
+    // --headless          : record without preview window (stop by Ctrl+C)
+    // --preview-rate <N>  : decode and show every Nth frame
+    // --preview-scale <S> : decode color at 1/S resolution (1, 2, 4, 8)
+    bool headless = false;
+    uint32_t preview_interval = 1;
+    int32_t preview_scale = 1;
+    try
+    {
+        for( int32_t i = 1; i < argc; i++ ){
+            const std::string option = argv[i];
+            if( option == "--headless" ){
+                headless = true;
+            }
+            else if( option == "--preview-rate" && i + 1 < argc ){
+                preview_interval = static_cast<uint32_t>( std::stoul( argv[++i] ) );
+            }
+            else if( option == "--preview-scale" && i + 1 < argc ){
+                preview_scale = std::stoi( argv[++i] );
+            }
+            else{
+                return usage( argv[0] );
+            }
+        }
+    }
+    catch (const std::exception &)
+    {
+        // Value of Option is not Number (std::invalid_argument), or Out of Range (std::out_of_range)
+        return usage( argv[0] );
+    }
+
     try
     {
         kinect kinect;
+        kinect.configure_preview( headless, preview_interval, preview_scale );
         kinect.run();
     }
     catch (const k4a::error &error)
@@ -16,4 +56,4 @@ int main(int argc, char *argv[])
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,441 @@
+/*
+ This is utility to that provides queues for pipelining capture, processing, and display stages.
+
+ k4a::bounded_queue<k4a::capture> queue( 4, k4a::drop_policy::drop_oldest );
+ queue.push( capture ); // capture thread
+ queue.pop( capture );  // worker thread
+
+ k4a::spsc_ring<k4a::capture> ring( 4, k4a::drop_policy::drop_oldest );
+ ring.push( capture );            // producer thread (evicts the oldest value if ring is full)
+ ring.pop_latest( capture );      // consumer thread (waits while ring is empty, and discards older values)
+ ring.try_pop( capture );         // consumer thread (doesn't wait)
+
+ Copyright (c) 2019 Tsukasa Sugiura <t.sugiura0204@gmail.com>
+ Licensed under the MIT license.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef __PIPELINE__
+#define __PIPELINE__
+
+#include <deque>
+#include <algorithm>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+namespace k4a
+{
+    // Policy for Pushing to Full Queue
+    enum class drop_policy
+    {
+        drop_oldest, // Drop the oldest value in queue, and push new value
+        block        // Wait until queue has space
+    };
+
+    // Bounded Queue between Pipeline Stages
+    template<typename T>
+    class bounded_queue
+    {
+    private:
+        std::deque<T> queue;
+        size_t capacity;
+        k4a::drop_policy policy;
+        bool closed;
+        uint64_t dropped;
+        size_t high_water_mark;
+        mutable std::mutex mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+
+    public:
+        bounded_queue( const size_t capacity = 4, const k4a::drop_policy policy = k4a::drop_policy::drop_oldest )
+            : capacity( capacity ),
+              policy( policy ),
+              closed( false ),
+              dropped( 0 ),
+              high_water_mark( 0 )
+        {
+        }
+
+        // Push Value (Return false if queue was closed)
+        bool push( T value )
+        {
+            std::unique_lock<std::mutex> lock( mutex );
+            if( policy == k4a::drop_policy::block ){
+                not_full.wait( lock, [&]{ return closed || queue.size() < capacity; } );
+            }
+
+            if( closed ){
+                return false;
+            }
+
+            if( queue.size() >= capacity ){
+                queue.pop_front();
+                dropped++;
+            }
+
+            queue.push_back( std::move( value ) );
+            high_water_mark = std::max( high_water_mark, queue.size() );
+            lock.unlock();
+            not_empty.notify_one();
+            return true;
+        }
+
+        // Pop Value (Return false if queue was closed and empty)
+        bool pop( T& value )
+        {
+            std::unique_lock<std::mutex> lock( mutex );
+            not_empty.wait( lock, [&]{ return closed || !queue.empty(); } );
+            if( queue.empty() ){
+                return false;
+            }
+
+            value = std::move( queue.front() );
+            queue.pop_front();
+            lock.unlock();
+            not_full.notify_one();
+            return true;
+        }
+
+        // Close Queue (Wake up all waiting threads)
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock( mutex );
+                closed = true;
+            }
+            not_empty.notify_all();
+            not_full.notify_all();
+        }
+
+        // Get Number of Dropped Values
+        uint64_t get_dropped() const
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            return dropped;
+        }
+
+        // Get Number of Values in Queue
+        size_t size() const
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            return queue.size();
+        }
+
+        // Get Maximum Number of Values in Queue
+        size_t get_high_water_mark() const
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            return high_water_mark;
+        }
+    };
+
+    // Lock-Free Single-Producer/Single-Consumer Ring Buffer
+    // (Values are stored by move. Push is called only from producer thread, pop is called only from consumer thread.)
+    // (Waiting thread spins and yields for a short time, and then it is parked on condition variable until it is woken up by other side.)
+    // NOTE: Producer evicts the oldest value with k4a::drop_policy::drop_oldest, so tail is advanced by both threads with compare-and-swap.
+    //       Slot that consumer is moving out is published in reading, and producer doesn't overwrite it until consumer finishes.
+    template<typename T>
+    class spsc_ring
+    {
+    private:
+        static constexpr size_t cache_line_size = 64;
+        static constexpr size_t spin_count = 64;
+        static constexpr size_t yield_count = 16;
+        static constexpr size_t none = ~static_cast<size_t>( 0 );
+
+        // Written by Producer
+        std::atomic<size_t> head;
+        std::atomic<uint64_t> dropped;
+        char head_padding[cache_line_size];
+
+        // Written by Consumer (tail is also advanced by producer when it evicts the oldest value)
+        std::atomic<size_t> tail;
+        std::atomic<size_t> reading;
+        size_t cached_head;
+        std::atomic<uint64_t> skipped;
+        char tail_padding[cache_line_size];
+
+        // Parking of Waiting Thread
+        std::atomic<uint32_t> waiting;
+        std::atomic<bool> closed;
+        std::mutex mutex;
+        std::condition_variable condition;
+
+        // NOTE: Buffer has one more slot than limit, so the newest slot is never the slot that consumer is moving out.
+        std::vector<T> buffer;
+        size_t limit;
+        size_t mask;
+        k4a::drop_policy policy;
+
+    public:
+        // Capacity is number of values in ring, and policy is for push() to full ring
+        spsc_ring( const size_t capacity = 4, const k4a::drop_policy policy = k4a::drop_policy::block )
+            : head( 0 ),
+              dropped( 0 ),
+              tail( 0 ),
+              reading( none ),
+              cached_head( 0 ),
+              skipped( 0 ),
+              waiting( 0 ),
+              closed( false ),
+              buffer( round_up( std::max<size_t>( capacity, 1 ) + 1 ) ),
+              limit( std::max<size_t>( capacity, 1 ) ),
+              mask( buffer.size() - 1 ),
+              policy( policy )
+        {
+        }
+
+        spsc_ring( const spsc_ring& ) = delete;
+        spsc_ring& operator=( const spsc_ring& ) = delete;
+
+        // Push Value (Return false if ring is full, value is not moved)
+        bool try_push( T& value )
+        {
+            const size_t h = head.load( std::memory_order_relaxed );
+            if( h - tail.load( std::memory_order_seq_cst ) >= limit ){
+                return false;
+            }
+
+            store( h, value );
+            return true;
+        }
+
+        bool try_push( T&& value )
+        {
+            return try_push( value );
+        }
+
+        // Push Value (Return false if ring was closed)
+        // (It waits while ring is full with k4a::drop_policy::block, or it evicts the oldest value with k4a::drop_policy::drop_oldest.)
+        bool push( T& value )
+        {
+            const size_t h = head.load( std::memory_order_relaxed );
+            size_t t = tail.load( std::memory_order_seq_cst );
+            while( h - t >= limit ){
+                if( closed.load( std::memory_order_acquire ) ){
+                    return false;
+                }
+
+                if( policy == k4a::drop_policy::block ){
+                    wait( [&]{ return h - tail.load( std::memory_order_seq_cst ) < limit || closed.load( std::memory_order_acquire ); } );
+                    t = tail.load( std::memory_order_seq_cst );
+                    continue;
+                }
+
+                // Evict the Oldest Value (Consumer can't pop it once tail is advanced)
+                if( tail.compare_exchange_weak( t, t + 1, std::memory_order_seq_cst ) ){
+                    release( t );
+                    dropped.fetch_add( 1, std::memory_order_relaxed );
+                    t++;
+                }
+            }
+
+            if( closed.load( std::memory_order_acquire ) ){
+                return false;
+            }
+
+            store( h, value );
+            return true;
+        }
+
+        bool push( T&& value )
+        {
+            return push( value );
+        }
+
+        // Pop Oldest Value (Return false if ring is empty)
+        bool try_pop( T& value )
+        {
+            size_t t = tail.load( std::memory_order_seq_cst );
+            while( true ){
+                // NOTE: Cached head may be behind tail after eviction.
+                if( cached_head <= t ){
+                    cached_head = head.load( std::memory_order_acquire );
+                    if( cached_head == t ){
+                        reading.store( none, std::memory_order_release );
+                        return false;
+                    }
+                }
+
+                // Claim Slot (Retry with new tail if producer evicted it)
+                reading.store( t & mask, std::memory_order_seq_cst );
+                if( tail.compare_exchange_weak( t, t + 1, std::memory_order_seq_cst ) ){
+                    break;
+                }
+            }
+
+            // Move out Value, and Release Resources held by Slot (e.g. k4a::capture handle)
+            value = std::move( buffer[t & mask] );
+            buffer[t & mask] = T();
+            reading.store( none, std::memory_order_release );
+            wake();
+            return true;
+        }
+
+        // Pop Latest Value (Older values in ring are discarded)
+        bool try_pop_latest( T& value )
+        {
+            if( !try_pop( value ) ){
+                return false;
+            }
+
+            while( try_pop( value ) ){
+                skipped.fetch_add( 1, std::memory_order_relaxed );
+            }
+            return true;
+        }
+
+        // Pop Oldest Value (Return false if ring was closed and empty)
+        bool pop( T& value )
+        {
+            while( !try_pop( value ) ){
+                if( closed.load( std::memory_order_acquire ) ){
+                    return try_pop( value );
+                }
+                wait( [&]{ return head.load( std::memory_order_acquire ) != tail.load( std::memory_order_seq_cst ) || closed.load( std::memory_order_acquire ); } );
+            }
+            return true;
+        }
+
+        // Pop Latest Value (Return false if ring was closed and empty)
+        bool pop_latest( T& value )
+        {
+            if( !pop( value ) ){
+                return false;
+            }
+
+            while( try_pop( value ) ){
+                skipped.fetch_add( 1, std::memory_order_relaxed );
+            }
+            return true;
+        }
+
+        // Close Ring (Wake up waiting thread)
+        void close()
+        {
+            closed.store( true, std::memory_order_release );
+            {
+                std::lock_guard<std::mutex> lock( mutex );
+            }
+            condition.notify_all();
+        }
+
+        // Get Number of Values Evicted by push()
+        uint64_t get_dropped() const
+        {
+            return dropped.load( std::memory_order_relaxed );
+        }
+
+        // Get Number of Values Discarded by try_pop_latest() or pop_latest()
+        uint64_t get_skipped() const
+        {
+            return skipped.load( std::memory_order_relaxed );
+        }
+
+        // Get Number of Values in Ring (Approximate if called from other threads)
+        size_t size() const
+        {
+            return head.load( std::memory_order_acquire ) - tail.load( std::memory_order_acquire );
+        }
+
+        size_t capacity() const
+        {
+            return limit;
+        }
+
+    private:
+        // Store Value to Slot of Head, and Publish it
+        void store( const size_t h, T& value )
+        {
+            // Wait until Consumer Finishes Moving out Slot
+            while( reading.load( std::memory_order_seq_cst ) == ( h & mask ) ){
+                std::this_thread::yield();
+            }
+
+            buffer[h & mask] = std::move( value );
+            head.store( h + 1, std::memory_order_release );
+            wake();
+        }
+
+        // Release Resources held by Evicted Slot
+        void release( const size_t t )
+        {
+            while( reading.load( std::memory_order_seq_cst ) == ( t & mask ) ){
+                std::this_thread::yield();
+            }
+
+            buffer[t & mask] = T();
+        }
+
+        // Wait until Predicate is Satisfied (Spin, yield, and then park)
+        template<typename predicate>
+        void wait( predicate ready )
+        {
+            for( size_t i = 0; i < spin_count; i++ ){
+                if( ready() ){
+                    return;
+                }
+            }
+
+            for( size_t i = 0; i < yield_count; i++ ){
+                if( ready() ){
+                    return;
+                }
+                std::this_thread::yield();
+            }
+
+            std::unique_lock<std::mutex> lock( mutex );
+            waiting.fetch_add( 1, std::memory_order_relaxed );
+            std::atomic_thread_fence( std::memory_order_seq_cst );
+            condition.wait( lock, ready );
+            waiting.fetch_sub( 1, std::memory_order_relaxed );
+        }
+
+        // Wake up Parked Thread
+        void wake()
+        {
+            std::atomic_thread_fence( std::memory_order_seq_cst );
+            if( waiting.load( std::memory_order_relaxed ) == 0 ){
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock( mutex );
+            }
+            condition.notify_all();
+        }
+
+        static size_t round_up( const size_t capacity )
+        {
+            size_t size = 1;
+            while( size < capacity ){
+                size <<= 1;
+            }
+            return size;
+        }
+    };
+}
+
+#endif // __PIPELINE__
@@ -2,10 +2,21 @@
 #include "util.h"
 
 #include <chrono>
+#include <iostream>
+#include <algorithm>
 
 // Constructor
 kinect::kinect( const uint32_t index )
-    : device_index( index )
+    : device_index( index ),
+      worker_count( 2 ),
+      queue_capacity( 4 ),
+      queue_policy( k4a::drop_policy::drop_oldest ),
+      running( false ),
+      captured_count( 0 ),
+      processed_count( 0 ),
+      display_dropped_count( 0 ),
+      displayed_count( 0 ),
+      profiler( { "capture", "process", "show" } )
 {
     // Initialize
     initialize();
@@ -27,183 +38,380 @@ void kinect::initialize()
 // Initialize Sensor
 inline void kinect::initialize_sensor()
 {
-    // Get Connected Devices
-    const int32_t device_count = k4a::device::get_installed_count();
-    if( device_count == 0 ){
-        throw k4a::error( "Failed to found device!" );
-    }
-
-    // Open Default Device
-    device = k4a::device::open( device_index );
-
-    // Start Cameras with Configuration
+    // Configuration
     device_configuration = K4A_DEVICE_CONFIG_INIT_DISABLE_ALL;
     device_configuration.color_format             = k4a_image_format_t::K4A_IMAGE_FORMAT_COLOR_BGRA32;
     device_configuration.color_resolution         = k4a_color_resolution_t::K4A_COLOR_RESOLUTION_720P;
     device_configuration.depth_mode               = k4a_depth_mode_t::K4A_DEPTH_MODE_NFOV_UNBINNED;
     device_configuration.synchronized_images_only = true;
     device_configuration.wired_sync_mode          = k4a_wired_sync_mode_t::K4A_WIRED_SYNC_MODE_STANDALONE;
-    device.start_cameras( &device_configuration );
+
+    // Open Device and Start Cameras
+    // (Synthetic source is used instead of device if K4A_SOURCE=synthetic is set.)
+    source = k4a::open_source( device_index, device_configuration );
 
     // Get Calibration
-    calibration = device.get_calibration( device_configuration.depth_mode, device_configuration.color_resolution );
+    calibration = source->get_calibration();
 
-    // Create Transformation
-    transformation = k4a::transformation( calibration );
+    // Create Monitor with Frame Rate
+    monitor.reset( new k4a::frame_monitor( device_configuration.camera_fps, { "capture", "process", "display" } ) );
 }
 
 // Finalize
 void kinect::finalize()
 {
-    // Destroy Transformation
-    transformation.destroy();
-
-    // Stop Cameras
-    device.stop_cameras();
-
-    // Close Device
-    device.close();
+    // Stop Cameras and Close Device
+    source->stop();
 
     // Close Window
     cv::destroyAllWindows();
 }
 
+// Configure Pipeline
+void kinect::configure_pipeline( const size_t workers, const size_t capacity, const k4a::drop_policy policy )
+{
+    worker_count   = std::max<size_t>( workers, 1 );
+    queue_capacity = std::max<size_t>( capacity, 1 );
+    queue_policy   = policy;
+}
+
+// Configure Profiler
+void kinect::configure_profiler( const std::string& file )
+{
+    profile_file = file;
+
+    // Keep Events for Trace
+    const std::string json = ".json";
+    if( file.size() >= json.size() && file.compare( file.size() - json.size(), json.size(), json ) == 0 ){
+        constexpr size_t trace_capacity = 1 << 18;
+        profiler.enable_trace( trace_capacity );
+    }
+}
+
 // Run
 void kinect::run()
 {
-    // Main Loop
-    while( true ){
-        // Update
-        update();
+    // Start Pipeline (Capture Thread -> Process Threads -> Display (Main Thread))
+    // NOTE: Pipeline is stopped before exception is rethrown, because joinable threads can't be destroyed.
+    try{
+        start_pipeline();
+        loop();
+    }
+    catch( ... ){
+        stop_pipeline();
+        throw;
+    }
+
+    // Stop Pipeline
+    stop_pipeline();
+}
 
-        // Draw
-        draw();
+// Loop
+void kinect::loop()
+{
+    // Main Loop
+    uint64_t displayed_sequence = 0;
+    uint64_t logged_dropped = 0;
+    std::chrono::steady_clock::time_point logged_time = std::chrono::steady_clock::now();
+    while( running ){
+        // Get Latest Frame from Process Threads
+        // (Older frames are returned to process threads without show, so that their output images are reused.)
+        frame latest;
+        size_t latest_index = 0;
+        bool updated = false;
+        for( size_t i = 0; i < frame_rings.size(); i++ ){
+            frame frame;
+            while( frame_rings[i]->try_pop( frame ) ){
+                if( frame.sequence < displayed_sequence || ( updated && frame.sequence < latest.sequence ) ){
+                    display_dropped_count++;
+                    release_frame( i, frame );
+                    continue;
+                }
+
+                if( updated ){
+                    display_dropped_count++;
+                    release_frame( latest_index, latest );
+                }
+                latest = std::move( frame );
+                latest_index = i;
+                updated = true;
+            }
+        }
 
-        // Show
-        show();
+        // Show Latest Frame
+        if( updated ){
+            displayed_sequence = latest.sequence;
+            color             = latest.color;
+            depth             = latest.depth;
+            transformed_color = latest.transformed_color;
+            transformed_depth = latest.transformed_depth;
+
+            // Show
+            {
+                k4a::profiler::scoped_timer timer( profiler, profile_show );
+                show();
+            }
+
+            displayed_count++;
+        }
 
         // Wait Key
-        constexpr int32_t delay = 30;
+        constexpr int32_t delay = 1;
         const int32_t key = cv::waitKey( delay );
         if( key == 'q' ){
             break;
         }
+
+        // Record Latency from Sensor to Display (Window is updated in cv::waitKey())
+        if( updated ){
+            profiler.record_latency( latest.timestamp, latest.system_timestamp, k4a::profiler::clock::now() );
+            monitor->record_age( monitor_display, latest.system_timestamp );
+
+            // Return Shown Frame to Process Thread (cv::imshow() keeps copy of image)
+            color.release();
+            depth.release();
+            transformed_color.release();
+            transformed_depth.release();
+            release_frame( latest_index, latest );
+        }
+
+        // Log Dropped Frames of Sensor (At most once per second)
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if( now - logged_time >= std::chrono::seconds( 1 ) ){
+            const uint64_t dropped = monitor->get_dropped();
+            if( dropped != logged_dropped ){
+                std::cout << "sensor dropped " << dropped - logged_dropped << " frames" << std::endl;
+                logged_dropped = dropped;
+            }
+            logged_time = now;
+        }
     }
 }
 
-// Update
-void kinect::update()
+// Start Pipeline
+void kinect::start_pipeline()
 {
-    // Update Frame
-    update_frame();
-
-    // Update Color
-    update_color();
+    // Create Rings (Rings of Captures, Frames, and Output Images for Each Process Thread)
+    // (Output images of process thread are in frame ring, in process stage, or in display stage, so capacity + 2 sets are enough.)
+    capture_rings.clear();
+    frame_rings.clear();
+    image_rings.clear();
+    const size_t image_count = queue_capacity + 2;
+    for( size_t i = 0; i < worker_count; i++ ){
+        capture_rings.emplace_back( new k4a::spsc_ring<std::pair<uint64_t, k4a::capture>>( queue_capacity, queue_policy ) );
+        frame_rings.emplace_back( new k4a::spsc_ring<frame>( queue_capacity, k4a::drop_policy::block ) );
+        image_rings.emplace_back( new k4a::spsc_ring<output_images>( image_count, k4a::drop_policy::block ) );
+
+        // Allocate Output Images (Each pool allocates its own images once)
+        for( size_t j = 0; j < image_count; j++ ){
+            k4a::frame_pool pool( calibration );
+            output_images images;
+            images.transformed_color_image = pool.get_transformed_color_image();
+            images.transformed_depth_image = pool.get_transformed_depth_image();
+            image_rings[i]->push( std::move( images ) );
+        }
+    }
 
-    // Update Depth
-    update_depth();
+    captured_count        = 0;
+    processed_count       = 0;
+    display_dropped_count = 0;
+    displayed_count       = 0;
+    running = true;
 
-    // Update Transformation
-    update_transformation();
+    // Start Capture Thread
+    capture_thread = std::thread( &kinect::capture_stage, this );
 
-    // Release Capture Handle
-    capture.reset();
-}
-
-// Update Frame
-inline void kinect::update_frame()
-{
-    // Get Capture Frame
-    constexpr std::chrono::milliseconds time_out( K4A_WAIT_INFINITE );
-    const bool result = device.get_capture( &capture, time_out );
-    if( !result ){
-        this->~kinect();
+    // Start Process Threads
+    for( size_t i = 0; i < worker_count; i++ ){
+        process_threads.emplace_back( &kinect::process_stage, this, i );
     }
 }
 
-// Update Color
-inline void kinect::update_color()
+// Stop Pipeline
+void kinect::stop_pipeline()
 {
-    // Get Color Image
-    color_image = capture.get_color_image();
-}
+    // Stop Threads (Wake up threads waiting on rings)
+    running = false;
+    for( std::unique_ptr<k4a::spsc_ring<std::pair<uint64_t, k4a::capture>>>& capture_ring : capture_rings ){
+        capture_ring->close();
+    }
+    for( std::unique_ptr<k4a::spsc_ring<frame>>& frame_ring : frame_rings ){
+        frame_ring->close();
+    }
+    for( std::unique_ptr<k4a::spsc_ring<output_images>>& image_ring : image_rings ){
+        image_ring->close();
+    }
+    if( capture_thread.joinable() ){
+        capture_thread.join();
+    }
+    for( std::thread& process_thread : process_threads ){
+        if( process_thread.joinable() ){
+            process_thread.join();
+        }
+    }
+    process_threads.clear();
+
+    // Count Captures Evicted in Capture Stage and Skipped in Process Stage
+    uint64_t capture_dropped_count = 0;
+    uint64_t skipped_count = 0;
+    for( std::unique_ptr<k4a::spsc_ring<std::pair<uint64_t, k4a::capture>>>& capture_ring : capture_rings ){
+        capture_dropped_count += capture_ring->get_dropped();
+        skipped_count += capture_ring->get_skipped();
+    }
 
-// Update Depth
-inline void kinect::update_depth()
-{
-    // Get Depth Image
-    depth_image = capture.get_depth_image();
+    // Show Statistics
+    std::cout << "captured  : " << captured_count << std::endl;
+    std::cout << "dropped   : " << capture_dropped_count << " (capture stage)" << std::endl;
+    std::cout << "dropped   : " << skipped_count << " (process stage)" << std::endl;
+    std::cout << "processed : " << processed_count << std::endl;
+    std::cout << "dropped   : " << display_dropped_count << " (display stage)" << std::endl;
+    std::cout << "displayed : " << displayed_count << std::endl;
+
+    // Show Dropped Frames of Sensor and Age of Frames
+    monitor->print( std::cout );
+
+    // Show Profile, and Write to File
+    profiler.print( std::cout );
+    if( !profile_file.empty() ){
+        profiler.write( profile_file );
+    }
 }
 
-// Update Transformation
-inline void kinect::update_transformation()
+// Capture Stage
+void kinect::capture_stage()
 {
-    if( !color_image.handle() || !depth_image.handle() ){
-        return;
+    uint64_t sequence = 0;
+    while( running ){
+        // Get Capture Frame
+        k4a::capture capture;
+        constexpr std::chrono::milliseconds time_out( 1000 );
+        try{
+            k4a::profiler::scoped_timer timer( profiler, profile_capture );
+            if( !source->get_capture( &capture, time_out ) ){
+                continue;
+            }
+        }
+        catch( const k4a::error& error ){
+            std::cout << error.what() << std::endl;
+            running = false;
+            break;
+        }
+        captured_count++;
+
+        // Check Timestamps of Images (Detect dropped frames of sensor)
+        monitor->update( capture );
+        monitor->record_age( monitor_capture, capture.get_depth_image() );
+
+        // Push Capture to Process Stage (Round Robin)
+        // (Wait while ring is full with drop_policy::block, or evict the oldest capture with drop_policy::drop_oldest.)
+        std::pair<uint64_t, k4a::capture> item( sequence, std::move( capture ) );
+        k4a::spsc_ring<std::pair<uint64_t, k4a::capture>>& capture_ring = *capture_rings[sequence % capture_rings.size()];
+        sequence++;
+        if( !capture_ring.push( item ) ){
+            break;
+        }
     }
-
-    // Transform Color Image to Depth Camera
-    transformed_color_image = transformation.color_image_to_depth_camera( depth_image, color_image );
-
-    // Transform Depth Image to Color Camera
-    transformed_depth_image = transformation.depth_image_to_color_camera( depth_image );
 }
 
-// Draw
-void kinect::draw()
+// Process Stage
+void kinect::process_stage( const size_t index )
 {
-    // Draw Color
-    draw_color();
+    // Create Transformation for This Thread
+    // NOTE: k4a::transformation is not shared between threads.
+    k4a::transformation transformation( calibration );
+
+    k4a::spsc_ring<std::pair<uint64_t, k4a::capture>>& capture_ring = *capture_rings[index];
+    k4a::spsc_ring<frame>& frame_ring = *frame_rings[index];
+    k4a::spsc_ring<output_images>& image_ring = *image_rings[index];
+
+    std::pair<uint64_t, k4a::capture> item;
+    output_images images;
+    while( running ){
+        // Pop Capture (Skip to Latest Capture if Drop Policy is Drop Oldest)
+        // (Wait while ring is empty, and leave loop when ring is closed.)
+        const bool result = ( queue_policy == k4a::drop_policy::block ) ? capture_ring.pop( item ) : capture_ring.pop_latest( item );
+        if( !result ){
+            break;
+        }
 
-    // Draw Depth
-    draw_depth();
+        // Pop Output Images Returned from Display Stage (Images are kept until frame is processed)
+        // (Wait while all images are in use, and leave loop when ring is closed.)
+        if( !images.transformed_color_image.handle() && !image_ring.pop( images ) ){
+            break;
+        }
 
-    // Draw Transformation
-    draw_transformation();
-}
+        frame frame;
+        frame.sequence = item.first;
+        bool processed = false;
+        try{
+            k4a::profiler::scoped_timer timer( profiler, profile_process );
+            processed = process_frame( item.second, transformation, images, frame );
+        }
+        catch( const k4a::error& error ){
+            std::cout << error.what() << std::endl;
+            running = false;
+            break;
+        }
+        item.second.reset();
+        if( !processed ){
+            continue;
+        }
+        processed_count++;
+        monitor->record_age( monitor_process, frame.system_timestamp );
 
-// Draw Color
-inline void kinect::draw_color()
-{
-    if( !color_image.handle() ){
-        return;
+        // Pass Frame to Display Stage (Display stage takes only latest frame)
+        // (Wait while ring is full, and leave loop when ring is closed.)
+        if( !frame_ring.push( frame ) ){
+            break;
+        }
     }
 
-    // Get cv::Mat from k4a::image
-    color = k4a::get_mat( color_image );
-
-    // Release Color Image Handle
-    color_image.reset();
+    transformation.destroy();
 }
 
-// Draw Depth
-inline void kinect::draw_depth()
+// Process Frame
+bool kinect::process_frame( k4a::capture& capture, const k4a::transformation& transformation, output_images& images, frame& frame )
 {
-    if( !depth_image.handle() ){
-        return;
+    k4a::image color_image = capture.get_color_image();
+    k4a::image depth_image = capture.get_depth_image();
+    if( !color_image.handle() || !depth_image.handle() ){
+        return false;
     }
 
-    // Get cv::Mat from k4a::image
-    depth = k4a::get_mat( depth_image );
-
-    // Release Depth Image Handle
-    depth_image.reset();
+    // Get Timestamps of Frame
+    frame.timestamp        = depth_image.get_device_timestamp();
+    frame.system_timestamp = depth_image.get_system_timestamp();
+
+    // Transform Images to Output Images (Images are reused, so nothing is allocated per frame)
+    transformation.color_image_to_depth_camera( depth_image, color_image, &images.transformed_color_image );
+    transformation.depth_image_to_color_camera( depth_image, &images.transformed_depth_image );
+
+    // Get cv::Mat from k4a::image (Shared without Copy)
+    frame.color             = k4a::get_mat( color_image, false );
+    frame.depth             = k4a::get_mat( depth_image, false );
+    frame.transformed_color = k4a::get_mat( images.transformed_color_image, false );
+    frame.transformed_depth = k4a::get_mat( images.transformed_depth_image, false );
+
+    // Hold Images in Frame until Display Stage Releases it
+    frame.color_image = std::move( color_image );
+    frame.depth_image = std::move( depth_image );
+    frame.images      = std::move( images );
+    return true;
 }
 
-// Draw Transformation
-inline void kinect::draw_transformation()
+// Release Frame
+void kinect::release_frame( const size_t index, frame& frame )
 {
-    if( !transformed_color_image.handle() || !transformed_depth_image.handle() ){
-        return;
-    }
-
-    // Get cv::Mat from k4a::image
-    transformed_color = k4a::get_mat( transformed_color_image );
-    transformed_depth = k4a::get_mat( transformed_depth_image );
-
-    // Release Transformed Image Handle
-    transformed_color_image.reset();
-    transformed_depth_image.reset();
+    // Release cv::Mat before Images, because they refer buffers of images
+    frame.color.release();
+    frame.depth.release();
+    frame.transformed_color.release();
+    frame.transformed_depth.release();
+    frame.color_image.reset();
+    frame.depth_image.reset();
+
+    // Return Output Images to Process Thread
+    image_rings[index]->push( std::move( frame.images ) );
 }
 
 // Show
@@ -4,31 +4,86 @@
 #include <k4a/k4a.hpp>
 #include <opencv2/opencv.hpp>
 
+#include "pool.h"
+#include "source.h"
+#include "pipeline.h"
+#include "profiler.h"
+#include "monitor.h"
+
+#include <thread>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <chrono>
+
 class kinect
 {
 private:
     // Kinect
-    k4a::device device;
-    k4a::capture capture;
+    std::unique_ptr<k4a::capture_source> source;
     k4a::calibration calibration;
-    k4a::transformation transformation;
     k4a_device_configuration_t device_configuration;
     uint32_t device_index;
 
     // Color
-    k4a::image color_image;
     cv::Mat color;
 
     // Depth
-    k4a::image depth_image;
     cv::Mat depth;
 
     // Transformed
-    k4a::image transformed_color_image;
-    k4a::image transformed_depth_image;
     cv::Mat transformed_color;
     cv::Mat transformed_depth;
 
+    // Output Images of Process Stage
+    // (Images are allocated with k4a::frame_pool when pipeline is started, and display stage returns them to process stage after show.)
+    struct output_images
+    {
+        k4a::image transformed_color_image;
+        k4a::image transformed_depth_image;
+    };
+
+    // Frame (Result of Process Stage)
+    // (Images are held by frame, because cv::Mat refers their buffers without copy.)
+    struct frame
+    {
+        uint64_t sequence = 0;
+        std::chrono::microseconds timestamp = std::chrono::microseconds( 0 );       // Device timestamp of depth image
+        std::chrono::nanoseconds system_timestamp = std::chrono::nanoseconds( 0 ); // System timestamp of depth image
+        k4a::image color_image;
+        k4a::image depth_image;
+        output_images images;
+        cv::Mat color;
+        cv::Mat depth;
+        cv::Mat transformed_color;
+        cv::Mat transformed_depth;
+    };
+
+    // Pipeline
+    size_t worker_count;
+    size_t queue_capacity;
+    k4a::drop_policy queue_policy;
+    std::atomic<bool> running;
+    std::vector<std::unique_ptr<k4a::spsc_ring<std::pair<uint64_t, k4a::capture>>>> capture_rings;
+    std::vector<std::unique_ptr<k4a::spsc_ring<frame>>> frame_rings;
+    std::vector<std::unique_ptr<k4a::spsc_ring<output_images>>> image_rings;
+    std::thread capture_thread;
+    std::vector<std::thread> process_threads;
+    std::atomic<uint64_t> captured_count;
+    std::atomic<uint64_t> processed_count;
+    std::atomic<uint64_t> display_dropped_count;
+    std::atomic<uint64_t> displayed_count;
+
+    // Profiler (Stages of pipeline)
+    enum profile_stage : size_t { profile_capture, profile_process, profile_show };
+    k4a::profiler profiler;
+    std::string profile_file;
+
+    // Monitor (Dropped frames of sensor, and age of frames at stages)
+    enum monitor_stage : size_t { monitor_capture, monitor_process, monitor_display };
+    std::unique_ptr<k4a::frame_monitor> monitor;
+
 public:
     // Constructor
     kinect( const uint32_t index = K4A_DEVICE_DEFAULT );
@@ -36,14 +91,15 @@ public:
     // Destructor
     ~kinect();
 
-    // Run
-    void run();
+    // Configure Pipeline (Call before run())
+    void configure_pipeline( const size_t workers, const size_t capacity, const k4a::drop_policy policy );
 
-    // Update
-    void update();
+    // Configure Profiler (Call before run())
+    // (Summary is written to *.csv, or trace is written to *.json as Chrome trace JSON when pipeline is stopped.)
+    void configure_profiler( const std::string& file );
 
-    // Draw
-    void draw();
+    // Run
+    void run();
 
     // Show
     void show();
@@ -58,26 +114,26 @@ private:
     // Finalize
     void finalize();
 
-    // Update Frame
-    void update_frame();
+    // Start Pipeline
+    void start_pipeline();
 
-    // Update Color
-    void update_color();
+    // Stop Pipeline
+    void stop_pipeline();
 
-    // Update Depth
-    void update_depth();
+    // Loop (Display Stage on Main Thread)
+    void loop();
 
-    // Update Transformation
-    void update_transformation();
+    // Capture Stage
+    void capture_stage();
 
-    // Draw Color
-    void draw_color();
+    // Process Stage
+    void process_stage( const size_t index );
 
-    // Draw Depth
-    void draw_depth();
+    // Process Frame
+    bool process_frame( k4a::capture& capture, const k4a::transformation& transformation, output_images& images, frame& frame );
 
-    // Draw Transformation
-    void draw_transformation();
+    // Return Output Images of Frame to Process Stage
+    void release_frame( const size_t index, frame& frame );
 
     // Show Color
     void show_color();
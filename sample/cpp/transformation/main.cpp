@@ -1,12 +1,32 @@
 #include <iostream>
 #include <sstream>
+#include <string>
 
 #include "kinect.hpp"
 
 int main( int argc, char* argv[] )
 {
     try{
+        // Parse Options
+        // transformation [--profile <csv|json>]
+        std::string profile_file;
+        for( int32_t i = 1; i < argc; i++ ){
+            const std::string option = argv[i];
+            if( option == "--profile" && i + 1 < argc ){
+                profile_file = argv[++i];
+            }
+        }
+
         kinect kinect;
+
+        // Profiler (Summary as CSV, or Trace as Chrome Trace JSON)
+        if( !profile_file.empty() ){
+            kinect.configure_profiler( profile_file );
+        }
+
+        // Pipeline (Process Threads, Capture Queue Capacity, Drop Policy for Full Queue)
+        kinect.configure_pipeline( 2, 4, k4a::drop_policy::drop_oldest );
+
         kinect.run();
     }
     catch( const k4a::error& error ){
@@ -0,0 +1,272 @@
+/*
+ This is utility to that monitors timestamps of frames for detecting dropped frames and measuring age of frames.
+ Dropped frames are detected from gaps of device timestamps in each stream, compared with period of configured frame rate.
+ Age of frame is measured on host at each stage from system timestamp (the time when image was arrived at host).
+
+ enum stage { capture, display };
+ k4a::frame_monitor monitor( K4A_FRAMES_PER_SECOND_30, { "capture", "display" } );
+ monitor.update( capture );                           // check timestamps of color, depth, and infrared images (call once per capture)
+ monitor.record_age( stage::display, depth_image );   // age of image at stage
+ k4a::frame_monitor::counters counters = monitor.get_counters( k4a::frame_monitor::stream::depth );
+ monitor.print( std::cout );
+
+ Copyright (c) 2019 Tsukasa Sugiura <t.sugiura0204@gmail.com>
+ Licensed under the MIT license.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef __MONITOR__
+#define __MONITOR__
+
+#include <k4a/k4a.hpp>
+
+#include "profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <iomanip>
+#include <cstdint>
+
+namespace k4a
+{
+    class frame_monitor
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        // Stream of Images
+        enum class stream : size_t
+        {
+            color,
+            depth,
+            infrared
+        };
+
+        // Counters of Stream
+        struct counters
+        {
+            uint64_t frames;                     // Number of received frames
+            uint64_t dropped;                    // Number of frames that are estimated as dropped from gaps
+            uint64_t gaps;                       // Number of gaps (delta of timestamps is longer than 1.5 periods)
+            uint64_t reordered;                  // Number of frames that timestamp is not later than previous frame
+            std::chrono::microseconds max_delta; // Longest delta of timestamps
+        };
+
+    private:
+        // State of Stream
+        // NOTE: Last timestamp is accessed only from the thread that calls update(), counters can be read from any threads.
+        struct stream_state
+        {
+            std::chrono::microseconds last_timestamp;
+            bool started;
+            std::atomic<uint64_t> frames;
+            std::atomic<uint64_t> dropped;
+            std::atomic<uint64_t> gaps;
+            std::atomic<uint64_t> reordered;
+            std::atomic<int64_t> max_delta;
+
+            stream_state()
+                : last_timestamp( 0 ),
+                  started( false ),
+                  frames( 0 ),
+                  dropped( 0 ),
+                  gaps( 0 ),
+                  reordered( 0 ),
+                  max_delta( 0 )
+            {
+            }
+        };
+
+        static const size_t stream_count = 3;
+
+        std::chrono::microseconds period;
+        stream_state streams[stream_count];
+        std::vector<std::string> names;
+        std::unique_ptr<latency_histogram[]> ages;
+
+    public:
+        // Constructor (Frame rate of device configuration, and names of stages that age is measured)
+        frame_monitor( const k4a_fps_t fps, const std::vector<std::string>& stages )
+            : period( get_period( fps ) ),
+              names( stages ),
+              ages( new latency_histogram[stages.size()] )
+        {
+        }
+
+        // Update Streams with Timestamps of Images in Capture
+        void update( const k4a::capture& capture )
+        {
+            update( stream::color, capture.get_color_image() );
+            update( stream::depth, capture.get_depth_image() );
+            update( stream::infrared, capture.get_ir_image() );
+        }
+
+        // Update Stream with Timestamp of Image
+        void update( const stream type, const k4a::image& image )
+        {
+            if( !image.handle() ){
+                return;
+            }
+
+            stream_state& state = streams[static_cast<size_t>( type )];
+            const std::chrono::microseconds timestamp = image.get_device_timestamp();
+            state.frames.fetch_add( 1, std::memory_order_relaxed );
+            if( !state.started ){
+                state.last_timestamp = timestamp;
+                state.started = true;
+                return;
+            }
+
+            const std::chrono::microseconds delta = timestamp - state.last_timestamp;
+            if( delta.count() <= 0 ){
+                state.reordered.fetch_add( 1, std::memory_order_relaxed );
+                return;
+            }
+            state.last_timestamp = timestamp;
+
+            if( delta.count() > state.max_delta.load( std::memory_order_relaxed ) ){
+                state.max_delta.store( delta.count(), std::memory_order_relaxed );
+            }
+
+            // Gap is longer than 1.5 periods, the number of missing periods are counted as dropped frames
+            if( delta * 2 > period * 3 ){
+                const int64_t missing = ( delta.count() + period.count() / 2 ) / period.count() - 1;
+                state.dropped.fetch_add( static_cast<uint64_t>( missing ), std::memory_order_relaxed );
+                state.gaps.fetch_add( 1, std::memory_order_relaxed );
+            }
+        }
+
+        // Record Age of Image at Stage (Lock-free, and can be called from any threads)
+        // (Image that doesn't have system timestamp (e.g. playback) is ignored.)
+        void record_age( const size_t stage, const k4a::image& image )
+        {
+            if( !image.handle() ){
+                return;
+            }
+            record_age( stage, image.get_system_timestamp() );
+        }
+
+        // Record Age of Frame that was Arrived at Host at System Timestamp
+        // NOTE: System timestamp is on host monotonic clock, same as std::chrono::steady_clock.
+        void record_age( const size_t stage, const std::chrono::nanoseconds system_timestamp )
+        {
+            if( system_timestamp.count() <= 0 ){
+                return;
+            }
+            ages[stage].record( clock::now().time_since_epoch() - system_timestamp );
+        }
+
+        // Get Counters of Stream
+        counters get_counters( const stream type ) const
+        {
+            const stream_state& state = streams[static_cast<size_t>( type )];
+            counters value;
+            value.frames    = state.frames.load( std::memory_order_relaxed );
+            value.dropped   = state.dropped.load( std::memory_order_relaxed );
+            value.gaps      = state.gaps.load( std::memory_order_relaxed );
+            value.reordered = state.reordered.load( std::memory_order_relaxed );
+            value.max_delta = std::chrono::microseconds( state.max_delta.load( std::memory_order_relaxed ) );
+            return value;
+        }
+
+        // Get Total Number of Dropped Frames of All Streams
+        uint64_t get_dropped() const
+        {
+            uint64_t dropped = 0;
+            for( const stream_state& state : streams ){
+                dropped += state.dropped.load( std::memory_order_relaxed );
+            }
+            return dropped;
+        }
+
+        // Get Histogram of Age at Stage
+        const latency_histogram& get_age( const size_t stage ) const
+        {
+            return ages[stage];
+        }
+
+        // Print Counters of Streams and Age of Frames at Stages
+        void print( std::ostream& stream ) const
+        {
+            const char* stream_names[stream_count] = { "color", "depth", "infrared" };
+            stream << std::setw( 24 ) << std::left << "stream" << std::right
+                   << std::setw( 10 ) << "frames"
+                   << std::setw( 10 ) << "dropped"
+                   << std::setw( 10 ) << "gaps"
+                   << std::setw( 10 ) << "reorder"
+                   << std::setw( 10 ) << "max gap" << " (ms)" << std::endl;
+            for( size_t i = 0; i < stream_count; i++ ){
+                const counters value = get_counters( static_cast<frame_monitor::stream>( i ) );
+                if( value.frames == 0 ){
+                    continue;
+                }
+                stream << std::setw( 24 ) << std::left << stream_names[i] << std::right
+                       << std::setw( 10 ) << value.frames
+                       << std::setw( 10 ) << value.dropped
+                       << std::setw( 10 ) << value.gaps
+                       << std::setw( 10 ) << value.reordered
+                       << std::setw( 10 ) << std::fixed << std::setprecision( 3 ) << value.max_delta.count() / 1000.0 << std::endl;
+            }
+
+            stream << std::setw( 24 ) << std::left << "age at stage" << std::right
+                   << std::setw( 10 ) << "count"
+                   << std::setw( 10 ) << "mean"
+                   << std::setw( 10 ) << "p50"
+                   << std::setw( 10 ) << "p99"
+                   << std::setw( 10 ) << "max" << " (ms)" << std::endl;
+            for( size_t i = 0; i < names.size(); i++ ){
+                const latency_histogram& age = ages[i];
+                stream << std::setw( 24 ) << std::left << names[i] << std::right
+                       << std::setw( 10 ) << age.get_count() << std::fixed << std::setprecision( 3 )
+                       << std::setw( 10 ) << to_milliseconds( age.get_mean() )
+                       << std::setw( 10 ) << to_milliseconds( age.get_percentile( 50.0 ) )
+                       << std::setw( 10 ) << to_milliseconds( age.get_percentile( 99.0 ) )
+                       << std::setw( 10 ) << to_milliseconds( age.get_max() ) << std::endl;
+            }
+        }
+
+    private:
+        // Get Period of Frame Rate
+        static std::chrono::microseconds get_period( const k4a_fps_t fps )
+        {
+            switch( fps ){
+                case K4A_FRAMES_PER_SECOND_5:
+                    return std::chrono::microseconds( 1000000 / 5 );
+                case K4A_FRAMES_PER_SECOND_15:
+                    return std::chrono::microseconds( 1000000 / 15 );
+                case K4A_FRAMES_PER_SECOND_30:
+                default:
+                    return std::chrono::microseconds( 1000000 / 30 );
+            }
+        }
+
+        // Convert Duration to Milliseconds
+        static double to_milliseconds( const std::chrono::nanoseconds duration )
+        {
+            return std::chrono::duration<double, std::milli>( duration ).count();
+        }
+    };
+}
+
+#endif // __MONITOR__
@@ -0,0 +1,589 @@
+/*
+ This is utility to that provides sources of captures (device, playback, and synthetic).
+ Synthetic source generates deterministic depth, infrared, and color frames with factory calibration shaped calibration,
+ so that samples can be run without device (e.g. on CI).
+
+ std::unique_ptr<k4a::capture_source> source = k4a::open_source( K4A_DEVICE_DEFAULT, device_configuration ); // synthetic source is used only if K4A_SOURCE=synthetic is set
+ k4a::calibration calibration = source->get_calibration();
+ source->get_capture( &capture, std::chrono::milliseconds( K4A_WAIT_INFINITE ) );
+
+ std::unique_ptr<k4a::capture_source> source( new k4a::synthetic_source( false ) ); // generate frames as fast as possible
+ source->start( device_configuration );
+
+ std::unique_ptr<k4a::capture_source> source( new k4a::playback_source( "file.mkv" ) ); // get_capture() returns false at EOF (only if k4arecord is available)
+
+ Copyright (c) 2019 Tsukasa Sugiura <t.sugiura0204@gmail.com>
+ Licensed under the MIT license.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#ifndef __SOURCE__
+#define __SOURCE__
+
+#include <k4a/k4a.h>
+#include <k4a/k4a.hpp>
+#include <opencv2/opencv.hpp>
+
+#if defined( __has_include )
+#if __has_include( <k4arecord/playback.hpp> )
+#include <k4arecord/playback.hpp>
+#define __SOURCE_PLAYBACK__
+#endif
+#endif
+
+#include <memory>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+
+namespace k4a
+{
+    // Abstract Source of Captures
+    class capture_source
+    {
+    public:
+        virtual ~capture_source() = default;
+
+        // Start Cameras with Configuration
+        virtual void start( const k4a_device_configuration_t& configuration ) = 0;
+
+        // Stop Cameras
+        virtual void stop() = 0;
+
+        // Get Calibration of Started Configuration
+        virtual k4a::calibration get_calibration() const = 0;
+
+        // Get Capture (Return false if timeout, or end of source)
+        virtual bool get_capture( k4a::capture* capture, const std::chrono::milliseconds timeout ) = 0;
+
+        // Get Device (Return nullptr if source is not device)
+        virtual const k4a::device* get_device() const
+        {
+            return nullptr;
+        }
+    };
+
+    // Source of Captures from Device
+    class device_source : public capture_source
+    {
+    private:
+        k4a::device device;
+        k4a_device_configuration_t configuration;
+
+    public:
+        device_source( const uint32_t index = K4A_DEVICE_DEFAULT )
+            : device( k4a::device::open( index ) ),
+              configuration( K4A_DEVICE_CONFIG_INIT_DISABLE_ALL )
+        {
+        }
+
+        ~device_source()
+        {
+            stop();
+        }
+
+        void start( const k4a_device_configuration_t& configuration ) override
+        {
+            this->configuration = configuration;
+            device.start_cameras( &this->configuration );
+        }
+
+        void stop() override
+        {
+            if( !device ){
+                return;
+            }
+
+            device.stop_cameras();
+            device.close();
+        }
+
+        k4a::calibration get_calibration() const override
+        {
+            return device.get_calibration( configuration.depth_mode, configuration.color_resolution );
+        }
+
+        bool get_capture( k4a::capture* capture, const std::chrono::milliseconds timeout ) override
+        {
+            return device.get_capture( capture, timeout );
+        }
+
+        const k4a::device* get_device() const override
+        {
+            return &device;
+        }
+    };
+
+    #ifdef __SOURCE_PLAYBACK__
+    // Source of Captures from Playback File
+    // NOTE: Configuration is ignored, captures are read as recorded.
+    class playback_source : public capture_source
+    {
+    private:
+        k4a::playback playback;
+
+    public:
+        playback_source( const std::string& path )
+            : playback( k4a::playback::open( path.c_str() ) )
+        {
+        }
+
+        ~playback_source()
+        {
+            stop();
+        }
+
+        void start( const k4a_device_configuration_t& ) override
+        {
+        }
+
+        void stop() override
+        {
+            playback.close();
+        }
+
+        k4a::calibration get_calibration() const override
+        {
+            return playback.get_calibration();
+        }
+
+        // Get Next Capture (Return false at EOF, timeout is ignored)
+        bool get_capture( k4a::capture* capture, const std::chrono::milliseconds ) override
+        {
+            return playback.get_next_capture( capture );
+        }
+
+        // Get Raw Calibration of Recording
+        std::vector<uint8_t> get_raw_calibration() const
+        {
+            return playback.get_raw_calibration();
+        }
+
+        // Get Configuration of Recording
+        k4a_record_configuration_t get_record_configuration() const
+        {
+            return playback.get_record_configuration();
+        }
+
+        // Seek to Device Timestamp (Next capture is the first capture at or after timestamp)
+        // NOTE: Offset from K4A_PLAYBACK_SEEK_BEGIN is relative to start timestamp of recording, not to device timestamp.
+        void seek( const std::chrono::microseconds timestamp )
+        {
+            const k4a_record_configuration_t record_configuration = playback.get_record_configuration();
+            const std::chrono::microseconds offset = timestamp - std::chrono::microseconds( record_configuration.start_timestamp_offset_usec );
+            playback.seek_timestamp( std::max( offset, std::chrono::microseconds( 0 ) ), k4a_playback_seek_origin_t::K4A_PLAYBACK_SEEK_BEGIN );
+        }
+    };
+    #endif
+
+    // Source of Synthetic Captures
+    // Depth is tilted plane with moving disk, infrared is pattern, and color is gradient with moving disk.
+    // Frames are deterministic, they depend only on configuration and frame number.
+    class synthetic_source : public capture_source
+    {
+    private:
+        bool realtime;
+        bool started;
+        k4a_device_configuration_t configuration;
+        k4a::calibration calibration;
+        uint64_t frame_number;
+        std::chrono::microseconds frame_period;
+        std::chrono::steady_clock::time_point next_frame_time;
+
+    public:
+        // If realtime is true, frames are generated at rate of configuration (camera_fps), otherwise as fast as possible.
+        synthetic_source( const bool realtime = true )
+            : realtime( realtime ),
+              started( false ),
+              configuration( K4A_DEVICE_CONFIG_INIT_DISABLE_ALL ),
+              frame_number( 0 ),
+              frame_period( 0 )
+        {
+        }
+
+        void start( const k4a_device_configuration_t& configuration ) override
+        {
+            if( configuration.color_resolution != K4A_COLOR_RESOLUTION_OFF &&
+                configuration.color_format != K4A_IMAGE_FORMAT_COLOR_BGRA32 && configuration.color_format != K4A_IMAGE_FORMAT_COLOR_MJPG ){
+                throw k4a::error( "Failed to start synthetic source! (color format must be BGRA32 or MJPG)" );
+            }
+
+            this->configuration = configuration;
+            calibration = create_calibration( configuration.depth_mode, configuration.color_resolution );
+            frame_number = 0;
+            frame_period = std::chrono::microseconds( 1000000 / get_fps( configuration.camera_fps ) );
+            next_frame_time = std::chrono::steady_clock::now();
+            started = true;
+        }
+
+        void stop() override
+        {
+            started = false;
+        }
+
+        k4a::calibration get_calibration() const override
+        {
+            return calibration;
+        }
+
+        bool get_capture( k4a::capture* capture, const std::chrono::milliseconds timeout ) override
+        {
+            if( !started ){
+                throw k4a::error( "Failed to get capture! (synthetic source is not started)" );
+            }
+
+            // Wait for Next Frame Time
+            if( realtime ){
+                const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                if( timeout.count() >= 0 && next_frame_time - now > timeout ){
+                    std::this_thread::sleep_for( timeout );
+                    return false;
+                }
+                std::this_thread::sleep_until( next_frame_time );
+
+                // Skip Frames if Consumer is Late (as same as device)
+                while( next_frame_time + frame_period <= std::chrono::steady_clock::now() ){
+                    next_frame_time += frame_period;
+                    frame_number++;
+                }
+                next_frame_time += frame_period;
+            }
+
+            *capture = create_capture( frame_number++ );
+            return true;
+        }
+
+        // Get Resolution of Depth Mode
+        static void get_depth_resolution( const k4a_depth_mode_t depth_mode, int32_t& width, int32_t& height )
+        {
+            switch( depth_mode ){
+                case K4A_DEPTH_MODE_NFOV_2X2BINNED: width = 320;  height = 288;  break;
+                case K4A_DEPTH_MODE_NFOV_UNBINNED:  width = 640;  height = 576;  break;
+                case K4A_DEPTH_MODE_WFOV_2X2BINNED: width = 512;  height = 512;  break;
+                case K4A_DEPTH_MODE_WFOV_UNBINNED:  width = 1024; height = 1024; break;
+                case K4A_DEPTH_MODE_PASSIVE_IR:     width = 1024; height = 1024; break;
+                default:                            width = 0;    height = 0;    break;
+            }
+        }
+
+        // Get Resolution of Color Resolution
+        static void get_color_resolution( const k4a_color_resolution_t color_resolution, int32_t& width, int32_t& height )
+        {
+            switch( color_resolution ){
+                case K4A_COLOR_RESOLUTION_720P:  width = 1280; height = 720;  break;
+                case K4A_COLOR_RESOLUTION_1080P: width = 1920; height = 1080; break;
+                case K4A_COLOR_RESOLUTION_1440P: width = 2560; height = 1440; break;
+                case K4A_COLOR_RESOLUTION_1536P: width = 2048; height = 1536; break;
+                case K4A_COLOR_RESOLUTION_2160P: width = 3840; height = 2160; break;
+                case K4A_COLOR_RESOLUTION_3072P: width = 4096; height = 3072; break;
+                default:                         width = 0;    height = 0;    break;
+            }
+        }
+
+        // Create Calibration that has Same Shape as Factory Calibration of Device
+        // (Brown-Conrady intrinsics of typical device, and color camera that is tilted 6 degrees from depth camera.)
+        static k4a::calibration create_calibration( const k4a_depth_mode_t depth_mode, const k4a_color_resolution_t color_resolution )
+        {
+            k4a::calibration calibration;
+            std::memset( static_cast<k4a_calibration_t*>( &calibration ), 0, sizeof( k4a_calibration_t ) );
+            calibration.depth_mode = depth_mode;
+            calibration.color_resolution = color_resolution;
+
+            // Depth Camera (Binned modes have half focal length)
+            int32_t width, height;
+            get_depth_resolution( depth_mode, width, height );
+            const bool binned = ( depth_mode == K4A_DEPTH_MODE_NFOV_2X2BINNED || depth_mode == K4A_DEPTH_MODE_WFOV_2X2BINNED );
+            const float depth_focal = binned ? 252.0f : 504.0f;
+            const float depth_coefficients[] = { 3.05f, 1.96f, 0.10f, 3.38f, 2.93f, 0.53f, 0.0f, 0.0f, -1.2e-5f, 4.6e-5f };
+            set_camera( calibration.depth_camera_calibration, width, height, depth_focal, depth_coefficients, 1.74f );
+
+            // Color Camera (4:3 modes and 16:9 modes are crops of same sensor)
+            get_color_resolution( color_resolution, width, height );
+            float color_scale = 1.0f;
+            switch( color_resolution ){
+                case K4A_COLOR_RESOLUTION_720P:  color_scale = 1.0f / 3.0f; break;
+                case K4A_COLOR_RESOLUTION_1080P: color_scale = 1.0f / 2.0f; break;
+                case K4A_COLOR_RESOLUTION_1440P: color_scale = 2.0f / 3.0f; break;
+                case K4A_COLOR_RESOLUTION_1536P: color_scale = 1.0f / 2.0f; break;
+                default:                         color_scale = 1.0f;        break;
+            }
+            const float color_coefficients[] = { 0.08f, -0.10f, 0.04f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 5.0e-4f, -2.0e-4f };
+            set_camera( calibration.color_camera_calibration, width, height, 1815.0f * color_scale, color_coefficients, 1.70f );
+
+            // Extrinsics between Sensors (Gyro and Accel are treated as same as depth camera)
+            const float angle = 6.0f * 3.14159265f / 180.0f;
+            k4a_calibration_extrinsics_t depth_to_color;
+            const float rotation[9] = { 1.0f, 0.0f, 0.0f, 0.0f, std::cos( angle ), -std::sin( angle ), 0.0f, std::sin( angle ), std::cos( angle ) };
+            const float translation[3] = { -32.0f, -2.0f, 4.0f };
+            std::memcpy( depth_to_color.rotation, rotation, sizeof( rotation ) );
+            std::memcpy( depth_to_color.translation, translation, sizeof( translation ) );
+
+            k4a_calibration_extrinsics_t to_depth[K4A_CALIBRATION_TYPE_NUM];
+            for( int32_t i = 0; i < K4A_CALIBRATION_TYPE_NUM; i++ ){
+                to_depth[i] = identity();
+            }
+            to_depth[K4A_CALIBRATION_TYPE_COLOR] = inverse( depth_to_color );
+
+            for( int32_t source = 0; source < K4A_CALIBRATION_TYPE_NUM; source++ ){
+                for( int32_t target = 0; target < K4A_CALIBRATION_TYPE_NUM; target++ ){
+                    calibration.extrinsics[source][target] = compose( inverse( to_depth[target] ), to_depth[source] );
+                }
+            }
+            calibration.depth_camera_calibration.extrinsics = identity();
+            calibration.color_camera_calibration.extrinsics = depth_to_color;
+
+            return calibration;
+        }
+
+    private:
+        static int32_t get_fps( const k4a_fps_t fps )
+        {
+            switch( fps ){
+                case K4A_FRAMES_PER_SECOND_5:  return 5;
+                case K4A_FRAMES_PER_SECOND_15: return 15;
+                default:                       return 30;
+            }
+        }
+
+        // Create Capture of Frame Number
+        k4a::capture create_capture( const uint64_t frame_number ) const
+        {
+            k4a::capture capture = k4a::capture::create();
+            const std::chrono::microseconds color_timestamp = frame_period * static_cast<int64_t>( frame_number );
+            const std::chrono::microseconds depth_timestamp = color_timestamp + std::chrono::microseconds( configuration.depth_delay_off_color_usec );
+            const std::chrono::nanoseconds system_timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() );
+            const int32_t phase = static_cast<int32_t>( frame_number % 1024 );
+
+            if( configuration.depth_mode != K4A_DEPTH_MODE_OFF ){
+                int32_t width, height;
+                get_depth_resolution( configuration.depth_mode, width, height );
+
+                if( configuration.depth_mode != K4A_DEPTH_MODE_PASSIVE_IR ){
+                    k4a::image depth_image = create_depth( width, height, phase );
+                    set_timestamp( depth_image, depth_timestamp, system_timestamp );
+                    capture.set_depth_image( depth_image );
+                }
+
+                k4a::image ir_image = create_infrared( width, height, phase );
+                set_timestamp( ir_image, depth_timestamp, system_timestamp );
+                capture.set_ir_image( ir_image );
+            }
+
+            if( configuration.color_resolution != K4A_COLOR_RESOLUTION_OFF ){
+                int32_t width, height;
+                get_color_resolution( configuration.color_resolution, width, height );
+
+                k4a::image color_image = create_color( width, height, phase, configuration.color_format );
+                set_timestamp( color_image, color_timestamp, system_timestamp );
+                capture.set_color_image( color_image );
+            }
+
+            return capture;
+        }
+
+        // Depth (Tilted plane from 1500mm to 2500mm, disk of 500mm closer moves horizontally, and border is invalid)
+        static k4a::image create_depth( const int32_t width, const int32_t height, const int32_t phase )
+        {
+            k4a::image image = k4a::image::create( K4A_IMAGE_FORMAT_DEPTH16, width, height, width * static_cast<int32_t>( sizeof( uint16_t ) ) );
+            const int32_t border = width / 64;
+            const int32_t radius = height / 6;
+            const int32_t center_x = ( phase * 4 ) % width;
+            const int32_t center_y = height / 2;
+            for( int32_t y = 0; y < height; y++ ){
+                uint16_t* row = reinterpret_cast<uint16_t*>( image.get_buffer() + y * image.get_stride_bytes() );
+                const uint16_t plane = static_cast<uint16_t>( 1500 + ( 1000 * y ) / height );
+                for( int32_t x = 0; x < width; x++ ){
+                    const int32_t dx = x - center_x;
+                    const int32_t dy = y - center_y;
+                    const bool invalid = ( x < border || y < border || x >= width - border || y >= height - border );
+                    const bool disk = ( dx * dx + dy * dy < radius * radius );
+                    row[x] = invalid ? 0 : disk ? static_cast<uint16_t>( plane - 500 ) : plane;
+                }
+            }
+            return image;
+        }
+
+        // Infrared (Checker pattern that scrolls)
+        static k4a::image create_infrared( const int32_t width, const int32_t height, const int32_t phase )
+        {
+            k4a::image image = k4a::image::create( K4A_IMAGE_FORMAT_IR16, width, height, width * static_cast<int32_t>( sizeof( uint16_t ) ) );
+            for( int32_t y = 0; y < height; y++ ){
+                uint16_t* row = reinterpret_cast<uint16_t*>( image.get_buffer() + y * image.get_stride_bytes() );
+                for( int32_t x = 0; x < width; x++ ){
+                    row[x] = ( ( ( x + phase ) / 32 + y / 32 ) % 2 ) ? 800 : 200;
+                }
+            }
+            return image;
+        }
+
+        // Color (Gradient with disk that moves horizontally)
+        static k4a::image create_color( const int32_t width, const int32_t height, const int32_t phase, const k4a_image_format_t format )
+        {
+            cv::Mat bgra( height, width, CV_8UC4 );
+            const int32_t radius = height / 6;
+            const int32_t center_x = ( phase * 8 ) % width;
+            const int32_t center_y = height / 2;
+            for( int32_t y = 0; y < height; y++ ){
+                uint8_t* row = bgra.ptr<uint8_t>( y );
+                for( int32_t x = 0; x < width; x++ ){
+                    const int32_t dx = x - center_x;
+                    const int32_t dy = y - center_y;
+                    const bool disk = ( dx * dx + dy * dy < radius * radius );
+                    row[4 * x + 0] = disk ? 255 : static_cast<uint8_t>( ( 255 * x ) / width );
+                    row[4 * x + 1] = disk ? 255 : static_cast<uint8_t>( ( 255 * y ) / height );
+                    row[4 * x + 2] = disk ? 255 : static_cast<uint8_t>( phase % 256 );
+                    row[4 * x + 3] = 255;
+                }
+            }
+
+            if( format == K4A_IMAGE_FORMAT_COLOR_MJPG ){
+                // Encode to Motion JPEG (Buffer is released by k4a::image)
+                cv::Mat bgr;
+                cv::cvtColor( bgra, bgr, cv::COLOR_BGRA2BGR );
+                std::vector<uint8_t> encoded;
+                cv::imencode( ".jpg", bgr, encoded );
+
+                uint8_t* buffer = new uint8_t[encoded.size()];
+                std::memcpy( buffer, encoded.data(), encoded.size() );
+                return k4a::image::create_from_buffer( K4A_IMAGE_FORMAT_COLOR_MJPG, width, height, 0, buffer, encoded.size(), release_buffer, nullptr );
+            }
+
+            k4a::image image = k4a::image::create( K4A_IMAGE_FORMAT_COLOR_BGRA32, width, height, width * 4 );
+            for( int32_t y = 0; y < height; y++ ){
+                std::memcpy( image.get_buffer() + y * image.get_stride_bytes(), bgra.ptr<uint8_t>( y ), static_cast<size_t>( width ) * 4 );
+            }
+            return image;
+        }
+
+        static void release_buffer( void* buffer, void* )
+        {
+            delete[] static_cast<uint8_t*>( buffer );
+        }
+
+        static void set_timestamp( k4a::image& image, const std::chrono::microseconds device_timestamp, const std::chrono::nanoseconds system_timestamp )
+        {
+            image.set_timestamp( device_timestamp );
+            image.set_system_timestamp( system_timestamp );
+        }
+
+        static void set_camera( k4a_calibration_camera_t& camera, const int32_t width, const int32_t height, const float focal, const float* coefficients, const float metric_radius )
+        {
+            camera.resolution_width = width;
+            camera.resolution_height = height;
+            camera.metric_radius = metric_radius;
+            camera.intrinsics.type = K4A_CALIBRATION_LENS_DISTORTION_MODEL_BROWN_CONRADY;
+            camera.intrinsics.parameter_count = 14;
+
+            k4a_calibration_intrinsic_parameters_t& parameters = camera.intrinsics.parameters;
+            parameters.param.cx = width / 2.0f;
+            parameters.param.cy = height / 2.0f;
+            parameters.param.fx = focal;
+            parameters.param.fy = focal;
+            parameters.param.k1 = coefficients[0];
+            parameters.param.k2 = coefficients[1];
+            parameters.param.k3 = coefficients[2];
+            parameters.param.k4 = coefficients[3];
+            parameters.param.k5 = coefficients[4];
+            parameters.param.k6 = coefficients[5];
+            parameters.param.codx = coefficients[6];
+            parameters.param.cody = coefficients[7];
+            parameters.param.p2 = coefficients[8];
+            parameters.param.p1 = coefficients[9];
+            parameters.param.metric_radius = metric_radius;
+        }
+
+        static k4a_calibration_extrinsics_t identity()
+        {
+            k4a_calibration_extrinsics_t extrinsics;
+            const float rotation[9] = { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+            std::memcpy( extrinsics.rotation, rotation, sizeof( rotation ) );
+            std::memset( extrinsics.translation, 0, sizeof( extrinsics.translation ) );
+            return extrinsics;
+        }
+
+        // Inverse of Rigid Transform (R^T, -R^T * t)
+        static k4a_calibration_extrinsics_t inverse( const k4a_calibration_extrinsics_t& extrinsics )
+        {
+            k4a_calibration_extrinsics_t result;
+            for( int32_t r = 0; r < 3; r++ ){
+                for( int32_t c = 0; c < 3; c++ ){
+                    result.rotation[r * 3 + c] = extrinsics.rotation[c * 3 + r];
+                }
+            }
+            for( int32_t r = 0; r < 3; r++ ){
+                result.translation[r] = 0.0f;
+                for( int32_t c = 0; c < 3; c++ ){
+                    result.translation[r] -= result.rotation[r * 3 + c] * extrinsics.translation[c];
+                }
+            }
+            return result;
+        }
+
+        // Composition of Rigid Transforms (second after first)
+        static k4a_calibration_extrinsics_t compose( const k4a_calibration_extrinsics_t& second, const k4a_calibration_extrinsics_t& first )
+        {
+            k4a_calibration_extrinsics_t result;
+            for( int32_t r = 0; r < 3; r++ ){
+                for( int32_t c = 0; c < 3; c++ ){
+                    result.rotation[r * 3 + c] = 0.0f;
+                    for( int32_t k = 0; k < 3; k++ ){
+                        result.rotation[r * 3 + c] += second.rotation[r * 3 + k] * first.rotation[k * 3 + c];
+                    }
+                }
+                result.translation[r] = second.translation[r];
+                for( int32_t k = 0; k < 3; k++ ){
+                    result.translation[r] += second.rotation[r * 3 + k] * first.translation[k];
+                }
+            }
+            return result;
+        }
+    };
+
+    // Open Source of Captures
+    // (Synthetic source is used instead of device only if environment variable K4A_SOURCE is "synthetic".)
+    inline std::unique_ptr<k4a::capture_source> open_source( const uint32_t index, const k4a_device_configuration_t& configuration )
+    {
+        std::unique_ptr<k4a::capture_source> source;
+        const char* name = std::getenv( "K4A_SOURCE" );
+        if( name && std::string( name ) == "synthetic" ){
+            std::cout << "synthetic source is used instead of device (K4A_SOURCE=synthetic)" << std::endl;
+            source.reset( new k4a::synthetic_source() );
+        }
+        else{
+            // Get Connected Devices
+            if( k4a::device::get_installed_count() <= index ){
+                throw k4a::error( "Failed to found device!" );
+            }
+            source.reset( new k4a::device_source( index ) );
+        }
+
+        source->start( configuration );
+        return source;
+    }
+}
+
+#endif // __SOURCE__